@@ -23,6 +23,33 @@
  * - Improved SD card error handling
  * - Watchdog timer added for stability
  * - AJAX-based web refresh (no full reload)
+ *
+ * CHANGES in v4.7.0:
+ * - Geohash grid: per-cell aggregation of transect data in PSRAM (/grid, /grid.csv)
+ * - Streaming GPX/KML export of a session track straight from the log (/export/gpx, /export/kml)
+ * - Log rows now carry the WindGust column announced in the header
+ * - Wind vane readout, 3-s gusts, 16-sector wind rose and calm spells per night (/windrose)
+ * - Nightly summary in NEXUS-Protokoll format, session end at sunrise or long press (/summary)
+ * - Binary record log (.bin) per session and cursor-based sync API with CRC32 (/sync, /sync/sessions)
+ * - Flash ring buffer fallback when the SD card fails, migrated to SD once it is back (/storage)
+ * - printf-free CSV row formatter (digit-pair tables, exact fixed point); -DNEXUS_BENCH boot benchmarks
+ * - Cooperative stackless tasks: non-blocking BME680 measurement cycle, GPS configuration with ACK
+ * - Attenuation, /data JSON and OLED screen computed lazily per measurement; OLED sleeps when idle (/perf)
+ * - Shared /data response cache per published snapshot with ETag/If-None-Match (304) and HEAD
+ * - Dual-number AD for attenuation/dew point: propagated BME680 uncertainty per band in log, /data, summary
+ * - SHA-256 hash chain over the binary log (.chain), HMAC-signed head at session end (.sig, /chain)
+ * - Lock-free fixed-block pools (web I/O buffers, NMEA lines) replace static/stack buffers; stats in /perf
+ * - Memory placement policy: hot state/tables in internal SRAM, grid in PSRAM with split key array (/memory)
+ * - Flash-cache-safe pulse path: anemometer on the PCNT hardware counter, rain ISR in IRAM with esp_timer; -DNEXUS_STRESS test
+ * - Runtime invariants with per-day health report (/health); -DNEXUS_SOAK time-lapse soak test with simulated sensors
+ * - -DNEXUS_FAULTS: scheduled SD/I2C/NMEA/web faults with per-phase jitter, lost records and recovery time (/faults)
+ * - Intervals aligned to GPS seconds (8-s UTC grid), interval-centred ms timestamps, per-channel age and staleness flags (log v2)
+ * - Multi-rate container per session (.nxm): wind 1 Hz, GPS per fix, BME per cycle, rain per tip, block index; host reader
+ * - HTTP over the native USB port (TinyUSB CDC, loopback into the same web server); AP can be switched off over USB (/link)
+ * - BLE status service: 20-byte status notification on change, access point on demand via BLE write
+ * - MQTT publisher in STA+AP mode: /data snapshot (QoS 0) and batched records (QoS 1) with the binary log as offline queue (/mqtt)
+ * - BME680 gas heater scheduled every GAS_EVERY_MIN minutes (off by default): gas resistance and IAQ in /data and the .nxm gas stream
+ * - Second BME680 at mast height (0x77): temperature difference, lapse rate and inversion flag in log v2, /data, summary and .nxm
  */
 
 
@@ -39,7 +66,61 @@
 #include <WiFi.h>
 #include <WebServer.h>
 #include <esp_task_wdt.h>
+#include <esp_partition.h>
+#include <type_traits>
+#include <atomic>
+#include <new>
+#include <mbedtls/md.h>
+#include <soc/soc_memory_layout.h>
+#include <driver/pcnt.h>
+#include <driver/gpio.h>
+#include <esp_timer.h>
+#include <esp_netif.h>
 #include "secrets.h"
+#ifndef SECRET_LOG_KEY
+#define SECRET_LOG_KEY ""   // leer = Sessions werden nicht signiert (nur Hash-Kette)
+#endif
+#ifndef USB_LINK            // Web-Interface ueber USB: Arduino-IDE "USB Mode: USB-OTG (TinyUSB)", "USB CDC On Boot: Disabled"
+#if defined(ARDUINO_USB_MODE) && ARDUINO_USB_MODE == 0 && !ARDUINO_USB_CDC_ON_BOOT
+#define USB_LINK 1
+#else
+#define USB_LINK 0
+#endif
+#endif
+#ifndef SECRET_STA_SSID
+#define SECRET_STA_SSID ""  // WLAN am Standort (LTE-Router, Laptop); leer = kein Stationsmodus, kein MQTT
+#define SECRET_STA_PASS ""
+#endif
+#ifndef MQTT_HOST
+#define MQTT_HOST ""        // Broker in diesem Netz, z. B. "192.168.8.10"
+#endif
+#ifndef MQTT_PORT
+#define MQTT_PORT 1883
+#endif
+#ifndef SECRET_BLE_PIN
+#define SECRET_BLE_PIN 0    // 6-stelliger Passkey fuer den BLE-Steuerkanal (Koppeln mit MITM-Schutz); 0 = kein BLE
+#endif
+#ifndef BLE_STATUS
+#define BLE_STATUS (SECRET_BLE_PIN != 0)   // Status per Bluetooth LE, AP bei Bedarf
+#endif
+#if BLE_STATUS && !SECRET_BLE_PIN
+#error "BLE_STATUS braucht SECRET_BLE_PIN in secrets.h, sonst koennte jedes Geraet in Reichweite den AP schalten"
+#endif
+#ifndef WIFI_AP_AT_BOOT
+#define WIFI_AP_AT_BOOT (!BLE_STATUS)   // 0 = Access Point erst auf Anforderung (BLE-Schreibzugriff oder /link?ap=1 ueber USB);
+#endif                                   // mit BLE standardmaessig 0, sonst laufen AP und BLE die ganze Nacht parallel
+#if !USB_LINK && !BLE_STATUS && !WIFI_AP_AT_BOOT
+#error "WIFI_AP_AT_BOOT 0 braucht USB_LINK oder BLE_STATUS, sonst ist die Station nicht erreichbar"
+#endif
+#if USB_LINK
+#include <USB.h>
+#endif
+#if BLE_STATUS
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLESecurity.h>
+#include <BLE2902.h>
+#endif
 
 // --- RETRO HTML & CSS ---
 const char STYLE_CPC[] PROGMEM = R"=====(
@@ -77,29 +158,252 @@ WebServer server(80);
 #define GPS_TX_PIN   D6
 #define ADDR_EXPANDER 0x20
 #define ADDR_BME      0x76
+#define ADDR_BME_UPPER 0x77  // zweiter BME680 oben am Mast (SDO auf 3V3); fehlt er, laeuft alles wie bisher
+#ifndef MAST_LOW_M
+#define MAST_LOW_M    2.0    // Messhoehen ueber Grund
+#endif
+#ifndef MAST_HIGH_M
+#define MAST_HIGH_M   10.0
+#endif
+#define MAST_OFFSET_K 0.0    // Abgleich oben gegen unten (beide Sensoren nebeneinander vergleichen)
+#define INVERSION_K   0.3    // Inversion ab dT oben-unten > 0.3 K, aus unter der Haelfte (Hysterese)
+#ifndef PIN_VBAT
+#define PIN_VBAT      -1    // Akkuspannung ueber Teiler an einem ADC-Pin (XIAO: alle Pins belegt)
+#endif
+#define VBAT_DIVIDER  2
+// BME680-Gassensor: Adafruit begin() heizt bei jeder Messung (320 C / 150 ms), der Wert wurde aber nie
+// gespeichert. Jetzt ist die Heizplatte aus und laeuft nur alle GAS_EVERY_MIN Minuten (0 = nie) fuer
+// GAS_BURST Messungen hintereinander; die ersten waermen nur vor, die letzte landet im Kanal "gas".
+#ifndef GAS_EVERY_MIN
+#define GAS_EVERY_MIN 0
+#endif
+#define GAS_HEATER_C  320
+#define GAS_HEATER_MS 150
+#define GAS_BURST     3
 
-U8G2_SSD1306_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0, U8X8_PIN_NONE);
-Adafruit_BME680 bme;
+// --- DAUERTEST (nur mit -DNEXUS_SOAK) ---
+// Zeitraffer auf dem Geraet, damit Fehler nach Wochen (Heap-Fragmentierung, Zaehlerueberlauf, Uhrendrift)
+// auf dem Tisch statt im Feld auffallen: millis() und die RTC laufen SOAK_SPEED-mal schneller, millis()
+// startet 10 min vor dem 49-Tage-Ueberlauf. BME680, Taster, RTC (mit 20 ppm Gangfehler), GPS und
+// Wind/Regen sind simuliert, Sessions starten abends und enden bei Sonnenaufgang (soakTick()).
+// Web-Last und Tagesberichte: python_scripts/nexus_soak_monitor.py, Invarianten: /health.
+#ifdef NEXUS_SOAK
+#ifndef SOAK_SPEED
+#define SOAK_SPEED         20
+#endif
+#define SOAK_MILLIS_START  (0xFFFFFFFFUL - 600000UL)
+#define SOAK_UNIX_START    1773594000UL   // 15.03.2026 17:00 UTC
+#define SOAK_RTC_PPM       20
+uint64_t soakMs() { return (uint64_t)esp_timer_get_time() * SOAK_SPEED / 1000; }
+uint32_t soakUnix() { return SOAK_UNIX_START + (uint32_t)(soakMs() / 1000); }   // wahre Zeit (= GPS)
+unsigned long soakMillis() { return (unsigned long)(SOAK_MILLIS_START + soakMs()); }
+#define millis() soakMillis()
+float soakNoise() { return esp_random() / 4294967295.0f - 0.5f; }
+struct SoakBme {
+  float temperature = 0, humidity = 0, pressure = 0; uint32_t gas_resistance = 0; unsigned long readyAt = 0; uint16_t heatMs = 150;
+  float lift = 0;        // Hoehe ueber dem unteren Sensor
+  bool begin(uint8_t addr) { lift = addr == ADDR_BME_UPPER ? MAST_HIGH_M - MAST_LOW_M : 0; return true; }
+  bool setGasHeater(uint16_t c, uint16_t ms) { heatMs = c && ms ? ms : 0; return true; }
+  unsigned long beginReading() { readyAt = millis() + 50 + heatMs; return readyAt; }
+  int remainingReadingMillis() { return (int)(readyAt - millis()); }
+  bool endReading() {   // Tagesgang mit Maximum 15 Uhr UTC, Druck schwankt im 5-Tage-Rhythmus
+    uint32_t u = soakUnix(); float day = 2 * PI * ((u % 86400) / 3600.0f - 9) / 24;
+    temperature = 10 + 5 * sinf(day) + 0.3f * soakNoise();
+    temperature += lift * (sinf(day) < 0 ? -0.4f * sinf(day) : -0.0098f);   // nachts Inversion, tags trockenadiabatisch
+    humidity = constrain(75 - 15 * sinf(day) + soakNoise(), 0.0f, 100.0f);
+    pressure = 101300 + 600 * sinf(2 * PI * u / (5 * 86400.0f)) + 10 * soakNoise();
+    gas_resistance = heatMs ? (uint32_t)(80000 + 30000 * sinf(day) + 2000 * soakNoise()) : 0; return true;
+  }
+} bme, bmeUpper;
+struct SoakRtc {
+  int64_t offsetMs = 0;
+  int64_t clockMs() { uint64_t v = soakMs(); return (int64_t)(v + v * SOAK_RTC_PPM / 1000000) + offsetMs; }
+  bool begin() { return true; }
+  DateTime now() { return DateTime((uint32_t)(SOAK_UNIX_START + clockMs() / 1000)); }
+  void adjust(const DateTime &t) { offsetMs += ((int64_t)t.unixtime() - SOAK_UNIX_START) * 1000 - clockMs(); }
+} rtc;
+struct SoakExpander { bool begin() { return true; } uint8_t read8() { return 0xFF; } } expander;   // kein Taster gedrueckt
+#else
+#define SOAK_SPEED 1
+Adafruit_BME680 bme, bmeUpper;
 RTC_PCF8563 rtc;
 PCF8574 expander(ADDR_EXPANDER);
+#endif
+U8G2_SSD1306_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0, U8X8_PIN_NONE);
 TinyGPSPlus gps;
 
+// Speicher-Platzierung: HOT = internes SRAM (klein, oft oder aus ISRs genutzt: Zaehler, Snapshots,
+// Aggregation, Nachschlagetabellen), BULK = PSRAM (gross, sequentiell durchlaufen: Raster).
+// Konstante Tabellen lagen ohne PLACE_HOT im Flash (.rodata) und gingen ueber den Flash-Cache,
+// der beim Schreiben in den Ring-Puffer sogar abgeschaltet ist. Uebersicht beim Booten: /memory
+#define PLACE_HOT DRAM_ATTR
+void* bulkCalloc(size_t n, size_t size) { return heap_caps_calloc(n, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT); }
+
 // Globale Variablen
-volatile unsigned long windCounts = 0, lastWindTime = 0, rainCounts = 0, lastRainTime = 0;
+// Impulse: Das Anemometer zaehlt der PCNT-Zaehler in Hardware (laeuft auch, waehrend der Flash-Cache
+// beim Schreiben in Ring-Puffer/NVS abgeschaltet ist). Er laeuft frei durch, windPoll() addiert nur die
+// Differenz zum letzten Stand (kein Loeschen -> kein Impuls geht zwischen Lesen und Loeschen verloren).
+// Der PCNT-Filter reicht nur bis 12,8 us: das Prellen des Reed-Kontakts (ca. 1 ms) unterdrueckt die
+// RC-Entprellung auf der Platine (10 kOhm Pull-Up, 100 nF gegen GND, siehe hardware/weather-station.md). Der Regenmesser
+// braucht die 200-ms-Entprellung und bleibt eine ISR - komplett im IRAM, Daten im DRAM, Zeit von
+// esp_timer_get_time() (IRAM-sicher). Registriert mit ESP_INTR_FLAG_IRAM, also auch bei Flash-Zugriffen aktiv.
+#define WIND_PCNT    PCNT_UNIT_0
+#define WIND_PCNT_LIM 32767   // Zaehler springt beim Erreichen auf 0 -> Differenzen modulo WIND_PCNT_LIM
+#define RAIN_DEBOUNCE_US 200000
+uint32_t windCounts = 0; int16_t windPcntLast = 0;
+PLACE_HOT volatile uint32_t rainCounts = 0;
+PLACE_HOT int64_t lastRainUs = -RAIN_DEBOUNCE_US;
 unsigned long lastLogCheck = 0, lastGustCheck = 0;
 float currentWindGust = 0.0, displayWindGust = 0.0, currentWindSpeedAverage = 0.0, intervalRainMM = 0.0, currentDewPoint = 0.0;
 String currentWindDirText = "---";
-float val_a20=0, val_a40=0, val_a55=0, val_a80=0, val_a110=0;
 int appState = 0, cloudCover = 0;
 bool isStationary = false, sdCardOK = false, timeSynced = false;
 String logFileName = ""; 
 int lastClkState = 1;
-unsigned long lastButtonPress = 0;
+unsigned long lastButtonPress = 0, lastSessionSave = 0;
 
-void IRAM_ATTR countWind() { unsigned long t = millis(); if (t - lastWindTime > 12) { windCounts++; lastWindTime = t; } }
-void IRAM_ATTR countRain() { unsigned long t = millis(); if (t - lastRainTime > 200) { rainCounts++; lastRainTime = t; } }
+void IRAM_ATTR countRain(void*) { int64_t t = esp_timer_get_time(); if (t - lastRainUs > RAIN_DEBOUNCE_US) { rainCounts++; lastRainUs = t; } }
+void windPoll() {
+  int16_t n = 0; if (pcnt_get_counter_value(WIND_PCNT, &n) != ESP_OK) return;
+  windCounts += (n - windPcntLast + WIND_PCNT_LIM) % WIND_PCNT_LIM; windPcntLast = n;   // jede Sekunde abgeholt, weit unter dem Umlauf
+}
+void pulseBegin() {
+  pinMode(PIN_WIND_SPD, INPUT_PULLUP);
+  pcnt_config_t c = {};
+  c.pulse_gpio_num = PIN_WIND_SPD; c.ctrl_gpio_num = PCNT_PIN_NOT_USED; c.unit = WIND_PCNT; c.channel = PCNT_CHANNEL_0;
+  c.pos_mode = PCNT_COUNT_DIS; c.neg_mode = PCNT_COUNT_INC; c.lctrl_mode = PCNT_MODE_KEEP; c.hctrl_mode = PCNT_MODE_KEEP;
+  c.counter_h_lim = WIND_PCNT_LIM; c.counter_l_lim = 0;
+  pcnt_unit_config(&c);
+  pcnt_set_filter_value(WIND_PCNT, 1023); pcnt_filter_enable(WIND_PCNT);   // max. 1023 APB-Takte = 12,8 us Glitch-Filter
+  pcnt_counter_pause(WIND_PCNT); pcnt_counter_clear(WIND_PCNT); windPcntLast = 0; pcnt_counter_resume(WIND_PCNT);
+  pinMode(PIN_RAIN, INPUT_PULLUP);
+  gpio_set_intr_type((gpio_num_t)PIN_RAIN, GPIO_INTR_NEGEDGE);
+  gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+  gpio_isr_handler_add((gpio_num_t)PIN_RAIN, countRain, nullptr);
+}
 String pad(int v) { return (v < 10) ? "0" + String(v) : String(v); }
 
+// --- FEHLERINJEKTION (nur mit -DNEXUS_FAULTS) ---
+// Fester Fahrplan ab dem ersten Messzyklus (mit -DNEXUS_SOAK im Zeitraffer): langsame und ausgefallene
+// SD-Karte, BME680 ohne I2C-Quittung, verfaelschte NMEA-Bytes und Web-Clients, die nie fertig senden
+// (die oeffnet nexus_soak_monitor.py, sobald /faults die Phase meldet). Ohne das Flag sind die Haken leer.
+// Auswertung je Phase (Jitter, verlorene Datensaetze, Erholzeit) weiter unten bei den Invarianten.
+#ifdef NEXUS_FAULTS
+enum FaultKind { FAULT_SD_SLOW, FAULT_SD_FAIL, FAULT_I2C_NACK, FAULT_NMEA_GARBAGE, FAULT_WEB_STALL };
+const char* const FAULT_NAMES[] = { "sd_slow", "sd_fail", "i2c_nack", "nmea_garbage", "web_stall" };
+struct FaultPhase { FaultKind kind; uint32_t startS, durS, param; };
+const FaultPhase FAULT_PLAN[] = {
+  { FAULT_SD_SLOW,       600, 120, 500 },   // +500 ms je SD-Schreibzugriff
+  { FAULT_SD_FAIL,      1200, 120, 0 },     // Karte antwortet nicht, auch nicht auf SD.begin()
+  { FAULT_I2C_NACK,     1800,  60, 0 },     // BME680 quittiert nicht
+  { FAULT_NMEA_GARBAGE, 2400, 120, 20 },    // 20 % der NMEA-Bytes verfaelscht
+  { FAULT_WEB_STALL,    3000, 120, 3 },     // 3 Verbindungen mit unvollstaendiger Anfrage
+};
+#define FAULT_PHASES (sizeof(FAULT_PLAN) / sizeof(FAULT_PLAN[0]))
+unsigned long faultT0 = 0;
+const FaultPhase* faultPhase(FaultKind k) {
+  if (!faultT0) return nullptr;
+  uint32_t s = (millis() - faultT0) / 1000;
+  for (const FaultPhase &f : FAULT_PLAN) if (f.kind == k && s >= f.startS && s < f.startS + f.durS) return &f;
+  return nullptr;
+}
+#define FAULT(k) (faultPhase(k) != nullptr)
+#define FAULT_DELAY(k) do { const FaultPhase* f_ = faultPhase(k); if (f_) delay(f_->param / SOAK_SPEED); } while (0)
+char faultNmea(char c) { const FaultPhase* f = faultPhase(FAULT_NMEA_GARBAGE); return f && esp_random() % 100 < f->param ? (char)esp_random() : c; }
+#else
+#define FAULT(k) false
+#define FAULT_DELAY(k) do {} while (0)
+#define faultNmea(c) (c)
+#endif
+
+// --- BLOCK-POOLS ---
+// Feste Bloecke statt malloc: Puffer mit wechselnder Lebensdauer (Web-Antworten, NMEA-Zeilen) kommen
+// aus typisierten Pools mit Groesse zur Compile-Zeit. alloc/release sind O(1) (Bitmap + CAS), lock-frei
+// und erzwungen inline, also auch aus einer IRAM_ATTR-ISR nutzbar (Pool dann mit DRAM_ATTR anlegen).
+// Kein Heap, keine Fragmentierung ueber mehrere Naechte; Zaehler und Hochwassermarke fuer /perf.
+#define POOL_INLINE inline __attribute__((always_inline))
+template <typename T, size_t N> struct BlockPool {
+  static_assert(N > 0 && N <= 1024, "BlockPool: 1..1024 Bloecke");
+  static_assert(ATOMIC_INT_LOCK_FREE == 2, "BlockPool braucht lock-freie 32-bit-Atomics");
+  static const size_t WORDS = (N + 31) / 32;
+  alignas(T) uint8_t store[N][sizeof(T)];
+  std::atomic<uint32_t> freeMap[WORDS];     // Bit gesetzt = Block frei
+  std::atomic<uint32_t> used, high, allocs, fails;
+  BlockPool() : used(0), high(0), allocs(0), fails(0) {
+    for (size_t w = 0; w < WORDS; w++) freeMap[w] = (w == WORDS - 1 && N % 32) ? (1u << (N % 32)) - 1 : 0xFFFFFFFFu;
+  }
+  POOL_INLINE T* alloc() {
+    for (size_t w = 0; w < WORDS; w++) {
+      uint32_t m = freeMap[w].load(std::memory_order_relaxed);
+      while (m) {
+        uint32_t bit = m & (~m + 1);
+        if (freeMap[w].compare_exchange_weak(m, m & ~bit, std::memory_order_acquire, std::memory_order_relaxed)) {
+          uint32_t u = used.fetch_add(1, std::memory_order_relaxed) + 1, h = high.load(std::memory_order_relaxed);
+          while (u > h && !high.compare_exchange_weak(h, u, std::memory_order_relaxed)) {}
+          allocs.fetch_add(1, std::memory_order_relaxed);
+          return reinterpret_cast<T*>(store[w * 32 + __builtin_ctz(bit)]);
+        }
+      }
+    }
+    fails.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  POOL_INLINE void release(T* p) {
+    if (!p) return;
+    size_t i = (reinterpret_cast<uint8_t*>(p) - store[0]) / sizeof(T);
+    freeMap[i / 32].fetch_or(1u << (i % 32), std::memory_order_release);
+    used.fetch_sub(1, std::memory_order_relaxed);
+  }
+  template <typename... A> T* make(A&&... a) { T* p = alloc(); return p ? new (p) T(static_cast<A&&>(a)...) : nullptr; }
+  void destroy(T* p) { if (p) { p->~T(); release(p); } }
+  // Leihgabe fuer einen Handler: gibt den Block am Ende des Scopes zurueck
+  struct Lease {
+    BlockPool &pool; T* p;
+    explicit Lease(BlockPool &bp) : pool(bp), p(bp.alloc()) {}
+    ~Lease() { pool.release(p); }
+    Lease(const Lease&) = delete; Lease& operator=(const Lease&) = delete;
+    explicit operator bool() const { return p != nullptr; }
+    T* operator->() const { return p; }
+  };
+  String json() const {
+    return "{\"size\":" + String((unsigned)N) + ",\"block\":" + String((unsigned)sizeof(T)) + ",\"used\":" + String(used.load()) + ",\"high\":" + String(high.load()) +
+           ",\"allocs\":" + String(allocs.load()) + ",\"fails\":" + String(fails.load()) + "}";
+  }
+};
+// Erst hier eingebunden: mit -DNEXUS_SOAK muss millis() in den Task-Makros schon die Zeitraffer-Uhr sein
+#include "nexus_tasks.h"
+#if defined(NEXUS_SOAK) && !defined(millis)
+#error "nexus_tasks.h muss nach der Zeitraffer-Uhr (#define millis() soakMillis()) stehen"
+#endif
+struct IoBuf { uint8_t b[1024]; };          // Web-Antworten (Export, Raster, Sync)
+struct NmeaLine { char s[GPS_LINE_MAX]; };
+BlockPool<IoBuf, 3> ioPool;
+typedef BlockPool<IoBuf, 3>::Lease IoLease;
+BlockPool<NmeaLine, 4> nmeaPool;
+
+// --- KOOPERATIVE TASKS --- (Makros und GPS-Quittungslogik in nexus_tasks.h, Host-Tests in tests/)
+struct MeasureTask : Task { unsigned long duration; bool bmeOk, upperOk; uint32_t epoch; uint64_t nextUtc, centreUtc, bmeUtc; } measureTask;
+GpsConfigTask gpsConfigTask;
+
+// NMEA-Zeilen mitschneiden (TinyGPS++ bekommt die Zeichen trotzdem), z.B. fuer PGKC-Quittungen.
+// Nur solange jemand zuhoert (nmeaListen); fertige Zeilen kommen als Pool-Block in eine kleine Queue.
+#define NMEA_QUEUE 4
+char nmeaBuf[sizeof(NmeaLine)]; uint8_t nmeaLen = 0; bool nmeaListen = false;
+NmeaLine* nmeaQueue[NMEA_QUEUE]; uint8_t nmeaHead = 0, nmeaTail = 0;
+void nmeaCollect(char c) {
+  if (c == '$') nmeaLen = 0;
+  if (c == '\r' || c == '\n') {
+    if (nmeaLen && nmeaListen && (uint8_t)(nmeaHead - nmeaTail) < NMEA_QUEUE) {
+      NmeaLine* l = nmeaPool.alloc();
+      if (l) { memcpy(l->s, nmeaBuf, nmeaLen); l->s[nmeaLen] = 0; nmeaQueue[nmeaHead++ % NMEA_QUEUE] = l; }
+    }
+    nmeaLen = 0; return;
+  }
+  if (nmeaLen < sizeof(nmeaBuf) - 1) nmeaBuf[nmeaLen++] = c;
+}
+NmeaLine* nmeaPop() { return nmeaHead != nmeaTail ? nmeaQueue[nmeaTail++ % NMEA_QUEUE] : nullptr; }
+void nmeaDrain() { NmeaLine* l; while ((l = nmeaPop())) nmeaPool.release(l); }
+
 // --- GPS TO RTC SYNC ---
 void syncRTCToGPS() {
   if (gps.date.isValid() && gps.time.isValid() && gps.date.year() > 2020) {
@@ -109,17 +413,1151 @@ void syncRTCToGPS() {
   }
 }
 
+// --- ZEITBASIS ---
+// UTC in ms zu jedem millis()-Wert: Der erste NMEA-Satz einer neuen GPS-Sekunde legt deren Beginn fest
+// (Empfangszeit minus Uebertragungsdauer). Ohne GPS-Zeit (oder nach 1 Tag ohne) zaehlt die RTC-Sekunde.
+// Mess- und Windrosen-Takt liegen auf diesem Raster: Intervallgrenzen bei vollen 8 s UTC.
+// Springt der Anker (RTC -> GPS, Neuabgleich nach TB_REBASE_MS, GPS weicht > 0.5 s ab), zaehlt tbEpoch
+// hoch; wer auf eine UTC-Zeit wartet, bestimmt sie dann neu.
+#define LOG_INTERVAL_MS  8000
+#define NMEA_LATENCY_MS  80          // ca. 70 Zeichen bei 9600 Baud nach der Sekundengrenze
+#define TB_REBASE_MS     86400000UL
+#define GPS_STALE_MS     2000        // Fix aelter als zwei GPS-Sekunden = veraltet
+#define TB_JUMP_MS       500
+uint32_t tbUnix = 0, tbEpoch = 0; unsigned long tbMillis = 0; bool tbGps = false;
+void timebaseUpdate() {
+  if (!gps.time.isUpdated() || !gps.date.isValid() || gps.date.year() <= 2020) return;
+  DateTime g(gps.date.year(), gps.date.month(), gps.date.day(), gps.time.hour(), gps.time.minute(), gps.time.second());
+  if (tbGps && g.unixtime() == tbUnix) return;   // RMC und GGA derselben Sekunde
+  unsigned long ms = millis() - gps.time.age() * SOAK_SPEED - NMEA_LATENCY_MS;
+  int64_t jump = (int64_t)g.unixtime() * 1000 - ((int64_t)tbUnix * 1000 + (int32_t)(ms - tbMillis));
+  if (!tbGps || jump > TB_JUMP_MS || jump < -TB_JUMP_MS) tbEpoch++;
+  tbUnix = g.unixtime(); tbMillis = ms; tbGps = true;
+}
+void timebaseCheck() { if (!tbUnix || millis() - tbMillis > TB_REBASE_MS) { tbUnix = rtc.now().unixtime(); tbMillis = millis(); tbGps = false; tbEpoch++; } }
+// ms - tbMillis ist ein millis()-Abstand (< TB_REBASE_MS), der Rest rechnet in int64
+uint64_t utcMs(unsigned long ms) { timebaseCheck(); return (uint64_t)((int64_t)tbUnix * 1000 + (int64_t)(int32_t)(ms - tbMillis)); }
+// Naechste Intervallgrenze, mindestens ein halbes Intervall entfernt (erstes Intervall einer Session 4..12 s)
+uint64_t nextLogBoundary(uint64_t u) { return ((u + LOG_INTERVAL_MS / 2) / LOG_INTERVAL_MS + 1) * LOG_INTERVAL_MS; }
+
 // --- BERECHNUNGEN ---
-float calculateDewPoint(float temp, float hum) { float b = 17.625, c = 243.04; float g = log(hum/100.0)+(b*temp)/(c+temp); return (c*g)/(b-g); }
-float calculateAlphaISO(float f, float T_c, float rh, float pa_hpa) {
-    float T = T_c + 273.15, Tr = 293.15, pr = 1013.25;
-    float p_sat = pow(10, (-6.8346 * pow(273.16/T, 1.261) + 4.6151));
-    float h = rh * p_sat * (pa_hpa/pr);
-    float frO = (pa_hpa/pr) * (24.0 + 4.04e4 * h * (0.02 + h) / (0.391 + h));
-    float frN = (pa_hpa/pr) * pow(T/Tr, -0.5) * (9.0 + 280.0 * h * exp(-4.170 * (pow(T/Tr, -1.0/3.0) - 1.0)));
-    float alpha = f * f * (1.84e-11 * pow(pa_hpa/pr, -1.0) * pow(T/Tr, 0.5) + pow(T/Tr, -2.5) * (0.01275 * exp(-2239.1/T) / (frO + f * f / frO) + 0.1068 * exp(-3352.0/T) / (frN + f * f / frN)));
+// Dual-Zahl fuer Vorwaertsdifferentiation: Wert plus Ableitungen nach (Temperatur, Feuchte, Druck).
+// Die Formeln unten sind Templates; mit float wie bisher, mit Dual liefert derselbe Durchlauf die
+// partiellen Ableitungen fuer die Fehlerfortpflanzung (statt Monte-Carlo).
+#define DUAL_N 3
+struct Dual {
+  float v, d[DUAL_N];
+  Dual(float x = 0) : v(x) { for (int i = 0; i < DUAL_N; i++) d[i] = 0; }
+  static Dual var(float x, int i) { Dual r(x); r.d[i] = 1; return r; }
+};
+inline Dual dualChain(const Dual &a, float v, float dv) { Dual r(v); for (int i = 0; i < DUAL_N; i++) r.d[i] = dv * a.d[i]; return r; }
+inline Dual operator+(Dual a, const Dual &b) { a.v += b.v; for (int i = 0; i < DUAL_N; i++) a.d[i] += b.d[i]; return a; }
+inline Dual operator-(Dual a, const Dual &b) { a.v -= b.v; for (int i = 0; i < DUAL_N; i++) a.d[i] -= b.d[i]; return a; }
+inline Dual operator-(const Dual &a) { return dualChain(a, -a.v, -1); }
+inline Dual operator*(const Dual &a, const Dual &b) { Dual r(a.v * b.v); for (int i = 0; i < DUAL_N; i++) r.d[i] = a.d[i] * b.v + a.v * b.d[i]; return r; }
+inline Dual operator/(const Dual &a, const Dual &b) { Dual r(a.v / b.v); for (int i = 0; i < DUAL_N; i++) r.d[i] = (a.d[i] * b.v - a.v * b.d[i]) / (b.v * b.v); return r; }
+// Mathe-Funktionen nur fuer echte Dual-Argumente (Template), sonst konkurrieren sie ueber den
+// impliziten float->Dual-Konstruktor mit den normalen float/double-Versionen.
+#define DUAL_ONLY(D) typename std::enable_if<std::is_same<D, Dual>::value, Dual>::type
+template <typename D> inline DUAL_ONLY(D) exp(const D &a) { float e = exp(a.v); return dualChain(a, e, e); }
+template <typename D> inline DUAL_ONLY(D) log(const D &a) { return dualChain(a, log(a.v), 1.0 / a.v); }
+template <typename D> inline DUAL_ONLY(D) pow(const D &a, float k) { float p = pow(a.v, k); return dualChain(a, p, k * p / a.v); }
+template <typename D> inline DUAL_ONLY(D) pow(float b, const D &a) { float p = pow(b, a.v); return dualChain(a, p, p * log(b)); }
+// Sensortoleranzen BME680 (Validierungsplan): +-0.5 C, +-3 % rH, +-0.6 hPa
+const float SIGMA_IN[DUAL_N] = { 0.5, 3.0, 0.6 };
+// 1-sigma-Unsicherheit aus den Ableitungen (unabhaengige Eingaenge, linearisiert)
+float dualSigma(const Dual &a) { float s = 0; for (int i = 0; i < DUAL_N; i++) s += sq(a.d[i] * SIGMA_IN[i]); return sqrt(s); }
+
+template <typename S> S calculateDewPoint(S temp, S hum) { float b = 17.625, c = 243.04; S g = log(hum/100.0)+(b*temp)/(c+temp); return (c*g)/(b-g); }
+template <typename S> S calculateAlphaISO(float f, S T_c, S rh, S pa_hpa) {
+    S T = T_c + 273.15; float Tr = 293.15, pr = 1013.25;
+    S p_sat = pow(10, (-6.8346 * pow(273.16/T, 1.261) + 4.6151));
+    S h = rh * p_sat * (pa_hpa/pr);
+    S frO = (pa_hpa/pr) * (24.0 + 4.04e4 * h * (0.02 + h) / (0.391 + h));
+    S frN = (pa_hpa/pr) * pow(T/Tr, -0.5) * (9.0 + 280.0 * h * exp(-4.170 * (pow(T/Tr, -1.0/3.0) - 1.0)));
+    S alpha = f * f * (1.84e-11 * pow(pa_hpa/pr, -1.0) * pow(T/Tr, 0.5) + pow(T/Tr, -2.5) * (0.01275 * exp(-2239.1/T) / (frO + f * f / frO) + 0.1068 * exp(-3352.0/T) / (frN + f * f / frN)));
     return alpha * 20.0 * log10(exp(1));
 }
+// --- ABGELEITETE GROESSEN (LAZY) ---
+// Jede neue Messung erhoeht measVersion. Daempfung, Web-JSON und OLED-Bild werden erst berechnet,
+// wenn jemand danach fragt, und bis zur naechsten Messung gemerkt. Was ins Log geht (Datensatz,
+// Taupunkt), bleibt im Zyklus. OLED geht nach OLED_IDLE_MS ohne Tastendruck aus, kurzer Druck weckt.
+#define OLED_IDLE_MS 120000
+const float ALPHA_FREQS[5] = { 20000.0, 40000.0, 55000.0, 80000.0, 110000.0 };
+uint32_t measVersion = 0;
+float alphaCache[5], alphaSigmaCache[5]; uint32_t alphaVer = UINT32_MAX;
+uint32_t oledVer = UINT32_MAX; unsigned long lastUserInput = 0; bool oledOn = true;
+// CPU-Zeit pro Zyklus: eager = Messung + Log + Baender, lazy = was Web/OLED seit der Messung nachgefordert haben
+struct CyclePerf { uint32_t eagerUs, lazyUs, idleN, obsN; uint64_t idleSum, obsSum; } perf;
+
+// Daempfung aller Baender samt fortgepflanzter Sensor-Unsicherheit (ein Dual-Durchlauf je Band)
+void alphaBands(float t, float rh, float p, float a[5], float u[5]) {
+  Dual T = Dual::var(t, 0), H = Dual::var(rh, 1), P = Dual::var(p, 2);
+  for (int k = 0; k < 5; k++) { Dual r = calculateAlphaISO(ALPHA_FREQS[k], T, H, P); a[k] = r.v; u[k] = dualSigma(r); }
+}
+float alphaBand(int i, bool sigma = false) {
+  if (alphaVer != measVersion) {
+    unsigned long t0 = micros();
+    alphaBands(bme.temperature, bme.humidity, bme.pressure / 100.0, alphaCache, alphaSigmaCache);
+    alphaVer = measVersion; perf.lazyUs += micros() - t0;
+  }
+  return sigma ? alphaSigmaCache[i] : alphaCache[i];
+}
+String chainHeadHex(int n);   // Hash-Kette, siehe unten
+enum MrStream { MR_WIND, MR_BME, MR_GPS, MR_RAIN, MR_GAS, MR_MAST, MR_DALPHA, MR_STREAMS };   // Multi-Rate-Log, siehe unten
+void mrPut(MrStream s, uint64_t t, const void* rec); void mrFlushAll(); void mrClose();
+uint32_t gasOhm = 0; float gasIaq = -1; uint64_t gasUtc = 0;   // letzte Gasmessung, siehe GASSENSOR
+
+// --- MAST (ZWEITE MESSHOEHE) ---
+// Abends bildet sich oft eine Inversion (oben waermer als unten): Fledermaeuse fliegen dann anders hoch,
+// und Ultraschall wird je Hoehe anders gedaempft. Mit einem zweiten BME680 auf MAST_HIGH_M wird je Zyklus
+// aus beiden Lesungen der Temperaturgradient (K/100 m, trockenadiabatisch = -0.98), das Inversions-Flag
+// und die Daempfungsdifferenz oben minus unten je Band berechnet (Druck oben barometrisch aus unten).
+// Im Datensatz stehen dT und die Flags (REC_MAST, REC_INVERSION), im Multi-Rate-Log die Kanaele "mast"
+// und "dalpha" (dB/km = mdB/m). Lange Mastkabel: I2C-Extender (z. B. P82B715) oder 100 kHz Takt.
+bool mastOk = false, mastValid = false, mastInv = false;
+float mastT = NAN, mastH = NAN, mastDT = 0, mastLapse = 0, mastDa[5];
+void mastCycle(bool fresh, float pLow, uint64_t t) {
+  mastValid = fresh;
+  if (!fresh) return;
+  const float dz = MAST_HIGH_M - MAST_LOW_M;
+  mastT = bmeUpper.temperature + MAST_OFFSET_K; mastH = constrain(bmeUpper.humidity, 0.0f, 100.0f);
+  mastDT = mastT - bme.temperature; mastLapse = mastDT / dz * 100;
+  mastInv = mastDT > (mastInv ? INVERSION_K / 2 : INVERSION_K);
+  float pUp = pLow * expf(-dz * 9.80665f / (287.05f * ((mastT + bme.temperature) / 2 + 273.15f)));
+  for (int k = 0; k < 5; k++)
+    mastDa[k] = calculateAlphaISO<float>(ALPHA_FREQS[k], mastT, mastH, pUp) - calculateAlphaISO<float>(ALPHA_FREQS[k], bme.temperature, bme.humidity, pLow);
+  struct __attribute__((packed)) { int16_t t; uint16_t h; int16_t lapse; uint8_t inv; } m = {
+    (int16_t)lroundf(mastT * 100), (uint16_t)lroundf(mastH * 100), (int16_t)constrain(lroundf(mastLapse * 100), -32767L, 32767L), mastInv };
+  int16_t da[5]; for (int k = 0; k < 5; k++) da[k] = (int16_t)constrain(lroundf(mastDa[k] * 1000), -32767L, 32767L);
+  mrPut(MR_MAST, t, &m); mrPut(MR_DALPHA, t, da);
+}
+// /data-Antwortcache: Der erste Abruf nach einer neuen Veroeffentlichung (pubVersion) serialisiert
+// einmal in einen statischen Puffer, alle weiteren Clients bekommen denselben Puffer bzw. 304 per ETag.
+// Veroeffentlicht wird mit jeder Messung, ausserhalb der Session alle 2 s (GPS-Fix vor dem Start sehen).
+#define DATA_PUBLISH_IDLE_MS 2000
+uint32_t pubVersion = 0, bootNonce = 0; unsigned long lastIdlePublish = 0;
+char dataBody[768]; int dataLen = 0; char dataETag[24]; uint32_t dataVer = UINT32_MAX;
+uint32_t dataHits = 0, dataMisses = 0, data304 = 0;
+void dataBuild() {
+  unsigned long t0 = micros();
+  char mast[160] = "";
+  if (mastValid) snprintf(mast, sizeof(mast), "\"t_up\":%.2f,\"h_up\":%.2f,\"lapse\":%.2f,\"inv\":%s,\"da\":[%.4f,%.4f,%.4f,%.4f,%.4f],",
+    mastT, mastH, mastLapse, mastInv ? "true" : "false", mastDa[0], mastDa[1], mastDa[2], mastDa[3], mastDa[4]);
+  dataLen = snprintf(dataBody, sizeof(dataBody), "{\"mode\":\"%s\",\"temp\":%.2f,\"hum\":%.2f,\"dew\":%.2f,\"pres\":%.2f,\"w_avg\":%.2f,\"w_gst\":%.2f,\"w_dir\":\"%s\",\"rain\":%.2f,"
+    "\"a20\":%.3f,\"a40\":%.3f,\"a55\":%.3f,\"a80\":%.3f,\"a110\":%.3f,\"u20\":%.3f,\"u40\":%.3f,\"u55\":%.3f,\"u80\":%.3f,\"u110\":%.3f,\"u_dew\":%.2f,\"gps_v\":%s,\"lat\":%.6f,\"lon\":%.6f,\"alt\":%.2f,\"sats\":%lu,\"synced\":%s,\"gas\":%lu,\"iaq\":%.1f,\"gas_age\":%ld,%s\"chain\":\"%s\",\"v\":%lu}",
+    isStationary ? "STAT" : "MOB", bme.temperature, bme.humidity, currentDewPoint, bme.pressure / 100.0, currentWindSpeedAverage, displayWindGust, currentWindDirText.c_str(), intervalRainMM,
+    alphaBand(0), alphaBand(1), alphaBand(2), alphaBand(3), alphaBand(4), alphaBand(0, true), alphaBand(1, true), alphaBand(2, true), alphaBand(3, true), alphaBand(4, true),
+    dualSigma(calculateDewPoint(Dual::var(bme.temperature, 0), Dual::var(bme.humidity, 1))), gps.location.isValid() ? "true" : "false", gps.location.lat(), gps.location.lng(), gps.altitude.meters(),
+    (unsigned long)gps.satellites.value(), timeSynced ? "true" : "false", (unsigned long)gasOhm, gasIaq, gasUtc ? (long)((utcMs(millis()) - gasUtc) / 1000) : -1L,
+    mast, chainHeadHex(4).c_str(), (unsigned long)pubVersion);
+  dataLen = min(dataLen, (int)sizeof(dataBody) - 1);
+  snprintf(dataETag, sizeof(dataETag), "\"%08lx-%lu\"", (unsigned long)bootNonce, (unsigned long)pubVersion);
+  dataVer = pubVersion; perf.lazyUs += micros() - t0;
+}
+void handleData() {
+  if (dataVer != pubVersion) { dataBuild(); dataMisses++; } else dataHits++;
+  server.sendHeader("ETag", dataETag); server.sendHeader("Cache-Control", "no-cache");
+  if (server.header("If-None-Match") == dataETag) { data304++; server.send(304); return; }
+  if (server.method() == HTTP_HEAD) { server.setContentLength(dataLen); server.send(200, "application/json", ""); return; }
+  server.send_P(200, "application/json", dataBody, dataLen);
+}
+void oledWake() { lastUserInput = millis(); if (!oledOn) { u8g2.setPowerSave(0); oledOn = true; oledVer = UINT32_MAX; } }
+// Messbildschirm (Zustand 2): nur neu zeichnen, wenn das Display an ist und es eine neue Messung gibt
+void oledRun() {
+  if (oledOn && millis() - lastUserInput >= OLED_IDLE_MS) { u8g2.setPowerSave(1); oledOn = false; }
+  if (!oledOn || oledVer == measVersion || !measVersion) return;
+  unsigned long t0 = micros(); float p = bme.pressure / 100.0;
+  u8g2.clearBuffer();
+  u8g2.setCursor(0, 12); u8g2.print("T: "); u8g2.print(bme.temperature, 1); u8g2.print("C  H: "); u8g2.print(bme.humidity, 0); u8g2.print("%");
+  u8g2.setCursor(0, 32); u8g2.print("P: "); u8g2.print(p, 0); u8g2.print("hPa DP: "); u8g2.print(currentDewPoint, 1);
+  u8g2.setCursor(0, 55); 
+  if (isStationary) u8g2.print("WIND: " + String(currentWindSpeedAverage, 1) + " m/s");
+  else { if (gps.location.isValid()) { u8g2.print(gps.location.lat(), 4); u8g2.print(" "); u8g2.print(gps.location.lng(), 4); } else u8g2.print("WAIT FOR GPS..."); }
+  u8g2.sendBuffer();
+  oledVer = measVersion; perf.lazyUs += micros() - t0;
+}
+// Vorigen Zyklus abschliessen: ohne Nachfrage zaehlt er als "idle", sonst als "beobachtet"
+void perfCycleClose() {
+  if (!measVersion) return;
+  uint32_t total = perf.eagerUs + perf.lazyUs;
+  if (perf.lazyUs) { perf.obsSum += total; perf.obsN++; } else { perf.idleSum += total; perf.idleN++; }
+  perf.lazyUs = 0;
+}
+void handlePerf() {
+  String j = "{\"version\":" + String(measVersion) + ",\"pub\":" + String(pubVersion) + ",\"eager_us\":" + String(perf.eagerUs) + ",\"lazy_us\":" + String(perf.lazyUs);
+  j += ",\"idle_cycles\":" + String(perf.idleN) + ",\"idle_avg_us\":" + String(perf.idleN ? (uint32_t)(perf.idleSum / perf.idleN) : 0);
+  j += ",\"observed_cycles\":" + String(perf.obsN) + ",\"observed_avg_us\":" + String(perf.obsN ? (uint32_t)(perf.obsSum / perf.obsN) : 0);
+  j += ",\"oled\":" + String(oledOn ? "true" : "false") + ",\"data_hits\":" + String(dataHits) + ",\"data_misses\":" + String(dataMisses) + ",\"data_304\":" + String(data304);
+  j += ",\"pools\":{\"io\":" + ioPool.json() + ",\"nmea\":" + nmeaPool.json() + "}}";
+  server.send(200, "application/json", j);
+}
+
+// --- RAEUMLICHE AGGREGATION (GEOHASH-RASTER) ---
+// Jede Messung mit GPS-Fix landet in einer Geohash-Zelle (Praezision 7 = ca. 153 x 153 m).
+// Die Zellen liegen in einer offenen Hash-Tabelle (Linear Probing) im PSRAM, Schluessel ist
+// der Geohash als Bitfolge. Pro Zelle: Anzahl, Summe (fuer Mittelwert), Min und Max je Kanal.
+// Schluessel und Zellen liegen getrennt: Beim Sondieren werden nur die dicht gepackten Schluessel
+// gelesen (4 pro 32-Byte-Cachezeile statt einer Zelle pro Zeile), die Zelle selbst nur einmal.
+#define GRID_PRECISION      7
+#define GRID_SLOTS          4096     // Zweierpotenz, 8 + 52 Byte pro Slot = 240 KB PSRAM
+#define GRID_MAX_FILL       3072     // max. 75% Fuellgrad, danach werden neue Zellen verworfen
+#define GRID_USED           0x8000000000000000ULL
+#define SESSION_SAVE_INTERVAL 600000 // Raster/Windrose alle 10 Minuten auf SD schreiben
+enum { GRID_TEMP, GRID_HUM, GRID_WIND, GRID_A55, GRID_CH };
+struct GridStat { float sum, min, max; };
+struct GridCell { uint32_t n; GridStat ch[GRID_CH]; };
+uint64_t* gridKeys = nullptr; GridCell* gridCells = nullptr;
+uint32_t gridUsed = 0, gridDropped = 0;
+PLACE_HOT const char GEOHASH_B32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+uint64_t geohashEncode(double lat, double lon, int prec) {
+  double la0 = -90, la1 = 90, lo0 = -180, lo1 = 180; uint64_t bits = 0;
+  for (int i = 0; i < prec * 5; i++) {
+    double &v0 = (i & 1) ? la0 : lo0, &v1 = (i & 1) ? la1 : lo1; double x = (i & 1) ? lat : lon, m = (v0 + v1) / 2;
+    if (x >= m) { bits = (bits << 1) | 1; v0 = m; } else { bits <<= 1; v1 = m; }
+  }
+  return bits;
+}
+void geohashCenter(uint64_t bits, int prec, double &lat, double &lon) {
+  double la0 = -90, la1 = 90, lo0 = -180, lo1 = 180;
+  for (int i = 0; i < prec * 5; i++) {
+    double &v0 = (i & 1) ? la0 : lo0, &v1 = (i & 1) ? la1 : lo1; double m = (v0 + v1) / 2;
+    if ((bits >> (prec * 5 - 1 - i)) & 1) v0 = m; else v1 = m;
+  }
+  lat = (la0 + la1) / 2; lon = (lo0 + lo1) / 2;
+}
+void geohashString(uint64_t bits, int prec, char* out) {
+  for (int i = 0; i < prec; i++) out[i] = GEOHASH_B32[(bits >> ((prec - 1 - i) * 5)) & 31];
+  out[prec] = 0;
+}
+
+bool gridBegin() {
+  gridKeys = (uint64_t*)bulkCalloc(GRID_SLOTS, sizeof(uint64_t));
+  gridCells = (GridCell*)bulkCalloc(GRID_SLOTS, sizeof(GridCell));
+  if (!gridKeys || !gridCells) { heap_caps_free(gridKeys); heap_caps_free(gridCells); gridKeys = nullptr; gridCells = nullptr; }
+  return gridCells != nullptr;
+}
+// Neue Session = leeres Raster (sonst landen Zellen der Vornacht in <session>-grid.csv)
+void gridReset() {
+  if (!gridCells) return;
+  memset(gridKeys, 0, GRID_SLOTS * sizeof(uint64_t)); memset(gridCells, 0, GRID_SLOTS * sizeof(GridCell));
+  gridUsed = gridDropped = 0;
+}
+void gridAdd(double lat, double lon, const float v[GRID_CH]) {
+  if (!gridCells) return;
+  uint64_t key = geohashEncode(lat, lon, GRID_PRECISION) | GRID_USED;
+  uint32_t i = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 52) & (GRID_SLOTS - 1);
+  while (gridKeys[i] && gridKeys[i] != key) i = (i + 1) & (GRID_SLOTS - 1);
+  GridCell &c = gridCells[i];
+  if (!gridKeys[i]) {
+    if (gridUsed >= GRID_MAX_FILL) { gridDropped++; return; }
+    gridKeys[i] = key; gridUsed++;
+    for (int k = 0; k < GRID_CH; k++) { c.ch[k].sum = 0; c.ch[k].min = v[k]; c.ch[k].max = v[k]; }
+  }
+  c.n++;
+  for (int k = 0; k < GRID_CH; k++) { c.ch[k].sum += v[k]; if (v[k] < c.ch[k].min) c.ch[k].min = v[k]; if (v[k] > c.ch[k].max) c.ch[k].max = v[k]; }
+}
+// Eine Zelle als CSV-Zeile (Datei) bzw. als kompaktes JSON-Array (Web-Overlay)
+int gridFormatCSV(uint64_t key, const GridCell &c, char* buf, size_t len) {
+  char gh[GRID_PRECISION + 1]; double lat, lon;
+  geohashString(key & ~GRID_USED, GRID_PRECISION, gh); geohashCenter(key & ~GRID_USED, GRID_PRECISION, lat, lon);
+  return snprintf(buf, len, "%s,%.6f,%.6f,%lu,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f,%.2f,%.2f,%.2f,%.3f,%.3f,%.3f\n", gh, lat, lon, (unsigned long)c.n,
+    c.ch[GRID_TEMP].sum / c.n, c.ch[GRID_TEMP].min, c.ch[GRID_TEMP].max, c.ch[GRID_HUM].sum / c.n, c.ch[GRID_HUM].min, c.ch[GRID_HUM].max,
+    c.ch[GRID_WIND].sum / c.n, c.ch[GRID_WIND].min, c.ch[GRID_WIND].max, c.ch[GRID_A55].sum / c.n, c.ch[GRID_A55].min, c.ch[GRID_A55].max);
+}
+int gridFormatJSON(uint64_t key, const GridCell &c, char* buf, size_t len) {
+  double lat, lon; geohashCenter(key & ~GRID_USED, GRID_PRECISION, lat, lon);
+  return snprintf(buf, len, "[%.6f,%.6f,%lu,%.2f,%.1f,%.2f,%.3f]", lat, lon, (unsigned long)c.n,
+    c.ch[GRID_TEMP].sum / c.n, c.ch[GRID_HUM].sum / c.n, c.ch[GRID_WIND].sum / c.n, c.ch[GRID_A55].sum / c.n);
+}
+const char GRID_CSV_HEADER[] = "Geohash,Lat,Lon,N,TempMean,TempMin,TempMax,HumMean,HumMin,HumMax,WindMean,WindMin,WindMax,A55Mean,A55Min,A55Max";
+
+void writeGridFile() {
+  if (!gridCells || !sdCardOK || logFileName == "") return;
+  String name = logFileName.substring(0, logFileName.length() - 4) + "-grid.csv";
+  File f = SD.open(name, FILE_WRITE);
+  if (!f) return;
+  f.println(GRID_CSV_HEADER);
+  char line[200];
+  for (uint32_t i = 0; i < GRID_SLOTS; i++) if (gridKeys[i]) { int n = gridFormatCSV(gridKeys[i], gridCells[i], line, sizeof(line)); f.write((const uint8_t*)line, n); }
+  f.close();
+}
+void handleGrid(bool csv) {
+  if (!gridCells) { server.send(503, "text/plain", "GRID DISABLED (NO PSRAM)"); return; }
+  IoLease io(ioPool);
+  if (!io) { server.send(503, "text/plain", "BUSY"); return; }
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  if (csv) { server.send(200, "text/csv", ""); server.sendContent(String(GRID_CSV_HEADER) + "\n"); }
+  else { server.send(200, "application/json", ""); server.sendContent("{\"prec\":" + String(GRID_PRECISION) + ",\"dropped\":" + String(gridDropped) + ",\"cells\":["); }
+  char* buf = (char*)io->b; const size_t cap = sizeof(io->b); size_t len = 0; bool first = true;
+  for (uint32_t i = 0; i < GRID_SLOTS; i++) {
+    if (!gridKeys[i]) continue;
+    if (len > cap - 200) { server.sendContent(buf, len); len = 0; }
+    if (!csv && !first) buf[len++] = ',';
+    len += csv ? gridFormatCSV(gridKeys[i], gridCells[i], buf + len, cap - len) : gridFormatJSON(gridKeys[i], gridCells[i], buf + len, cap - len);
+    first = false;
+  }
+  if (len) server.sendContent(buf, len);
+  if (!csv) server.sendContent("]}");
+  server.sendContent("");
+}
+
+// --- WINDRICHTUNG & WINDROSE ---
+// Die Sparkfun-Windfahne schaltet je Richtung einen anderen Widerstand gegen den 10k Pull-up.
+// Jede Sekunde wird die Fahne gelesen und die Impulse der letzten Sekunde ausgewertet:
+// Sektor (16) x Geschwindigkeitsklasse -> Sekunden im Histogramm, Flaute separat.
+#define ROSE_SECTORS   16
+#define ROSE_CLASSES   6
+#define WIND_CALM_MS   0.5      // darunter gilt es als Flaute (ohne Richtung)
+#define CALM_MIN_SPELL 60       // Flauten ab 60 s zaehlen als Flautenphase
+#define ROSE_MIN_DT    0.2      // kuerzere Proben verwerfen (Impulse bleiben fuer die naechste stehen)
+const float VANE_OHMS[ROSE_SECTORS] = { 33000, 6570, 8200, 891, 1000, 688, 2200, 1410, 3900, 3140, 16000, 14120, 120000, 42120, 64900, 21880 };
+const char* const DIR_TEXT[ROSE_SECTORS] = { "N", "NNE", "NE", "ENE", "E", "ESE", "SE", "SSE", "S", "SSW", "SW", "WSW", "W", "WNW", "NW", "NNW" };
+const float ROSE_CLASS_MIN[ROSE_CLASSES] = { 0.5, 2.0, 4.0, 6.0, 8.0, 11.0 };
+uint32_t roseHist[ROSE_SECTORS][ROSE_CLASSES];
+uint32_t roseCalmSec = 0, roseCalmSpells = 0, roseLongestCalm = 0, roseCurrentCalm = 0, roseTotalSec = 0;
+unsigned long lastRoseSample = 0, windPrevCount = 0; uint64_t roseNextUtc = 0; uint32_t roseEpoch = 0;
+float gustWin[3] = { 0, 0, 0 }; int gustIdx = 0;
+float dirSumX = 0, dirSumY = 0; int currentWindDirDeg = -1; uint32_t rainPrevCount = 0;
+
+int readVaneSector() {
+  float mv = analogReadMilliVolts(PIN_WIND_DIR), best = 1e9; int sec = 0;
+  for (int i = 0; i < ROSE_SECTORS; i++) {
+    float d = fabs(mv - 3300.0 * VANE_OHMS[i] / (VANE_OHMS[i] + 10000.0));
+    if (d < best) { best = d; sec = i; }
+  }
+  return sec;
+}
+void roseReset() {
+  memset(roseHist, 0, sizeof(roseHist));
+  roseCalmSec = roseCalmSpells = roseLongestCalm = roseCurrentCalm = roseTotalSec = 0;
+}
+// 1-Sekunden-Probe: Windrose, Flauten, 3-s-Boee (WMO) und Richtungsvektor fuers Log-Intervall.
+// false = zu kurz seit der letzten Probe, nichts ausgewertet (der Aufrufer behaelt lastRoseSample).
+bool roseSample(float dt) {
+  if (!(dt >= ROSE_MIN_DT)) return false;
+  windPoll();
+  float speed = (windCounts - windPrevCount) / dt * 0.6667; windPrevCount = windCounts;
+  int sec = readVaneSector();
+  uint64_t t = (utcMs(millis()) + 500) / 1000 * 1000;   // Ende der ausgewerteten Sekunde
+  struct __attribute__((packed)) { uint16_t speed; int16_t dir; } w = { (uint16_t)lroundf(speed * 100), (int16_t)(speed < WIND_CALM_MS ? -1 : lroundf(sec * 22.5f)) };
+  mrPut(MR_WIND, t, &w);
+  noInterrupts(); uint32_t rc = rainCounts; interrupts();
+  if (rc > rainPrevCount) { uint8_t tips = min(rc - rainPrevCount, (uint32_t)255); mrPut(MR_RAIN, t, &tips); rainPrevCount = rc; }
+  roseTotalSec++;
+  if (speed < WIND_CALM_MS) {
+    roseCalmSec++; roseCurrentCalm++;
+    if (roseCurrentCalm > roseLongestCalm) roseLongestCalm = roseCurrentCalm;
+  } else {
+    if (roseCurrentCalm >= CALM_MIN_SPELL) roseCalmSpells++;
+    roseCurrentCalm = 0;
+    int c = ROSE_CLASSES - 1; while (c > 0 && speed < ROSE_CLASS_MIN[c]) c--;
+    roseHist[sec][c]++;
+    dirSumX += speed * sin(sec * 22.5 * DEG_TO_RAD); dirSumY += speed * cos(sec * 22.5 * DEG_TO_RAD);
+  }
+  gustWin[gustIdx] = speed; gustIdx = (gustIdx + 1) % 3;
+  float g = (gustWin[0] + gustWin[1] + gustWin[2]) / 3.0;
+  if (g > currentWindGust) currentWindGust = g;
+  return true;
+}
+// Sessionstart: Impulse und Boeen-Fenster von vorher verwerfen
+void windReset() {
+  windPoll(); windCounts = windPrevCount = 0;
+  memset(gustWin, 0, sizeof(gustWin)); gustIdx = 0; currentWindGust = 0; dirSumX = dirSumY = 0;
+}
+// Abschluss eines Log-Intervalls: mittlere Richtung (geschwindigkeitsgewichtet) und Boee uebernehmen
+void windIntervalClose() {
+  if (dirSumX == 0 && dirSumY == 0) { currentWindDirDeg = -1; currentWindDirText = "---"; }
+  else {
+    float deg = atan2(dirSumX, dirSumY) * RAD_TO_DEG; if (deg < 0) deg += 360;
+    currentWindDirDeg = (int)(deg + 0.5) % 360; currentWindDirText = DIR_TEXT[(int)((deg + 11.25) / 22.5) % ROSE_SECTORS];
+  }
+  displayWindGust = currentWindGust; currentWindGust = 0; dirSumX = dirSumY = 0;
+}
+uint32_t roseCalmSpellsTotal() { return roseCalmSpells + (roseCurrentCalm >= CALM_MIN_SPELL ? 1 : 0); }
+
+String roseJSON() {
+  String j = "{\"sectors\":16,\"classes\":[0.5,2,4,6,8,11],\"total_s\":" + String(roseTotalSec) + ",\"calm_s\":" + String(roseCalmSec) + ",\"calm_spells\":" + String(roseCalmSpellsTotal()) + ",\"longest_calm_s\":" + String(roseLongestCalm) + ",\"current_calm_s\":" + String(roseCurrentCalm) + ",\"hist\":[";
+  for (int i = 0; i < ROSE_SECTORS; i++) {
+    j += (i ? ",[" : "[");
+    for (int c = 0; c < ROSE_CLASSES; c++) { if (c) j += ","; j += String(roseHist[i][c]); }
+    j += "]";
+  }
+  return j + "]}";
+}
+// Binaerformat: "NXWR", Version, Sektoren, Klassen, 4x uint32 Flaute, dann uint32 hist[16][6] (little endian)
+size_t roseBinary(uint8_t* out) {
+  uint32_t hdr[4] = { roseTotalSec, roseCalmSec, roseCalmSpellsTotal(), roseLongestCalm };
+  memcpy(out, "NXWR", 4); out[4] = 1; out[5] = ROSE_SECTORS; out[6] = ROSE_CLASSES; out[7] = 0;
+  memcpy(out + 8, hdr, sizeof(hdr)); memcpy(out + 8 + sizeof(hdr), roseHist, sizeof(roseHist));
+  return 8 + sizeof(hdr) + sizeof(roseHist);
+}
+void writeRoseFile() {
+  if (!sdCardOK || logFileName == "") return;
+  File f = SD.open(logFileName.substring(0, logFileName.length() - 4) + "-rose.json", FILE_WRITE);
+  if (f) { f.print(roseJSON()); f.close(); }
+}
+
+// --- NACHT-ZUSAMMENFASSUNG ---
+// Wird jedes Log-Intervall fortgeschrieben, damit das Protokoll bei Sessionende ohne
+// Nachbearbeitung vorliegt. Zeiten in Sekunden, gewichtet mit der Intervalldauer.
+#define WIND_CUTIN_MS  6.0      // Abschalt-Algorithmus WKA: Fledermausaktivitaet unterhalb
+#define TEMP_BAT_MIN   10.0     // ... und ab dieser Temperatur, bei trockenem Wetter
+#define SESSION_MIN_SUNRISE 3600000  // Sonnenaufgang beendet Sessions erst nach 1 h Laufzeit
+#define LONG_PRESS_MS  3000
+const float WIND_LIMITS[4] = { 2.0, 4.0, 6.0, 8.0 };
+struct Stat {
+  float min, max; double sum; uint32_t n;
+  void reset() { min = 1e9; max = -1e9; sum = 0; n = 0; }
+  void add(float v) { if (isnan(v)) return; if (v < min) min = v; if (v > max) max = v; sum += v; n++; }
+  float mean() const { return n ? sum / n : NAN; }
+};
+struct NightSummary {
+  uint32_t startUnix, endUnix, records;
+  Stat temp, hum, dew, pres, wind, dTemp;
+  float gustMax, rainMM, rainSec, batSec, totalSec, belowSec[4], invSec;
+  double windX, windY, alphaSum[5], alphaSigmaSum[5];
+  double lat, lon; uint32_t sats; bool hasFix;
+  const char* endReason;
+} night;
+unsigned long sessionStartMillis = 0, lastButtonPoll = 0, buttonDownSince = 0;
+bool buttonReleased = true;
+int sunriseDay = -1, sunriseMin = -1, lastDayMin = -1;
+
+void summaryReset(uint32_t unixNow) {
+  memset(&night, 0, sizeof(night));
+  night.temp.reset(); night.hum.reset(); night.dew.reset(); night.pres.reset(); night.wind.reset(); night.dTemp.reset();
+  night.startUnix = unixNow; night.endReason = "laufend";
+}
+void summaryAdd(float dt, float p, const float a[5], const float u[5]) {
+  night.records++; night.totalSec += dt;
+  night.temp.add(bme.temperature); night.hum.add(bme.humidity); night.dew.add(currentDewPoint); night.pres.add(p); night.wind.add(currentWindSpeedAverage);
+  if (displayWindGust > night.gustMax) night.gustMax = displayWindGust;
+  night.rainMM += intervalRainMM; if (intervalRainMM > 0) night.rainSec += dt;
+  for (int i = 0; i < 4; i++) if (currentWindSpeedAverage < WIND_LIMITS[i]) night.belowSec[i] += dt;
+  if (currentWindSpeedAverage < WIND_CUTIN_MS && bme.temperature >= TEMP_BAT_MIN && intervalRainMM == 0) night.batSec += dt;
+  if (mastValid) { night.dTemp.add(mastDT); if (mastInv) night.invSec += dt; }
+  if (currentWindDirDeg >= 0) { night.windX += currentWindSpeedAverage * sin(currentWindDirDeg * DEG_TO_RAD); night.windY += currentWindSpeedAverage * cos(currentWindDirDeg * DEG_TO_RAD); }
+  for (int i = 0; i < 5; i++) { night.alphaSum[i] += a[i]; night.alphaSigmaSum[i] += u[i]; }
+  if (gps.location.isValid()) { night.lat = gps.location.lat(); night.lon = gps.location.lng(); night.sats = gps.satellites.value(); night.hasFix = true; }
+}
+int summaryWindDir() { if (night.windX == 0 && night.windY == 0) return -1; int d = (int)(atan2(night.windX, night.windY) * RAD_TO_DEG + 360.5) % 360; return d; }
+String fmtUnix(uint32_t t) {
+  if (!t) return "--";
+  DateTime d(t); char b[24]; snprintf(b, sizeof(b), "%04d-%02d-%02d %02d:%02d:%02d", d.year(), d.month(), d.day(), d.hour(), d.minute(), d.second());
+  return String(b);
+}
+String hours(float sec) { return String(sec / 3600.0, 1) + " h"; }
+
+// Protokoll im Format von README.md ("NEXUS-Protokoll"), Nachtwerte statt Momentaufnahme
+String summaryText() {
+  uint32_t endT = night.endUnix ? night.endUnix : rtc.now().unixtime(); int dir = summaryWindDir();
+  String t = "NEXUS-Nachtprotokoll\n";
+  t += "Session:      " + logFileName + " (" + String(isStationary ? "stationaer" : "mobil") + ")\n";
+  t += "Beginn:       " + fmtUnix(night.startUnix) + " UTC" + (timeSynced ? " (GPS-synchronisiert)" : " (RTC)") + "\n";
+  t += "Ende:         " + fmtUnix(endT) + " UTC (" + night.endReason + ")\n";
+  t += "Messungen:    " + String(night.records) + " (" + hours(night.totalSec) + ")\n";
+  t += "Temperatur:   " + String(night.temp.min, 2) + " / " + String(night.temp.mean(), 2) + " / " + String(night.temp.max, 2) + " C (min/mittel/max)\n";
+  t += "Luftfeuchte:  " + String(night.hum.min, 1) + " / " + String(night.hum.mean(), 1) + " / " + String(night.hum.max, 1) + " % rH\n";
+  t += "Taupunkt:     " + String(night.dew.min, 1) + " / " + String(night.dew.mean(), 1) + " / " + String(night.dew.max, 1) + " C\n";
+  t += "Luftdruck:    " + String(night.pres.min, 1) + " / " + String(night.pres.mean(), 1) + " / " + String(night.pres.max, 1) + " hPa\n";
+  t += "Wind:         " + String(night.wind.mean(), 1) + " m/s" + (dir >= 0 ? " aus " + String(dir) + " Grad" : String("")) + " (Boeen max: " + String(night.gustMax, 1) + " m/s)\n";
+  t += "Windstunden:  ";
+  for (int i = 0; i < 4; i++) t += "< " + String(WIND_LIMITS[i], 0) + " m/s: " + hours(night.belowSec[i]) + (i < 3 ? " | " : "\n");
+  t += "Flaute:       " + hours(roseCalmSec) + ", " + String(roseCalmSpellsTotal()) + " Phasen, laengste " + String(roseLongestCalm / 60) + " min\n";
+  t += "Regen:        " + String(night.rainMM, 1) + " mm (" + hours(night.rainSec) + " mit Niederschlag)\n";
+  t += "Bewoelkung:   " + String(cloudCover) + "/8 Oktas\n";
+  t += "Position:     " + (night.hasFix ? String(night.lat, 6) + ", " + String(night.lon, 6) + " (GPS AIR530, " + String(night.sats) + " Satelliten)" : String("kein GPS-Fix")) + "\n";
+  if (night.dTemp.n) t += "Schichtung:   dT " + String(MAST_HIGH_M, 0) + " m - " + String(MAST_LOW_M, 0) + " m: " + String(night.dTemp.min, 1) + " / " + String(night.dTemp.mean(), 1) + " / " + String(night.dTemp.max, 1) + " K, Inversion " + hours(night.invSec) + "\n";
+  t += "Fledermauswetter (Wind < " + String(WIND_CUTIN_MS, 0) + " m/s, T >= " + String(TEMP_BAT_MIN, 0) + " C, trocken): " + hours(night.batSec) + "\n\n";
+  t += "Atmosphaerische Daempfung (ISO 9613-1, Nachtmittel):\n";
+  for (int i = 0; i < 5; i++) t += "- " + String((int)(ALPHA_FREQS[i] / 1000)) + " kHz: " + String(night.records ? night.alphaSum[i] / night.records : 0.0, 2) + " +- " + String(night.records ? night.alphaSigmaSum[i] / night.records : 0.0, 2) + " dB/m\n";
+  t += "(+- = Sensortoleranz BME680 fortgepflanzt: 0.5 C, 3 % rH, 0.6 hPa)\n";
+  return t;
+}
+String summaryJSON() {
+  String j = "{\"file\":\"" + logFileName + "\",\"start\":" + String(night.startUnix) + ",\"end\":" + String(night.endUnix) + ",\"end_reason\":\"" + night.endReason + "\",\"records\":" + String(night.records);
+  j += ",\"hours\":" + String(night.totalSec / 3600.0, 2);
+  j += ",\"temp\":[" + String(night.temp.min, 2) + "," + String(night.temp.mean(), 2) + "," + String(night.temp.max, 2) + "]";
+  j += ",\"hum\":[" + String(night.hum.min, 1) + "," + String(night.hum.mean(), 1) + "," + String(night.hum.max, 1) + "]";
+  j += ",\"pres\":[" + String(night.pres.min, 1) + "," + String(night.pres.mean(), 1) + "," + String(night.pres.max, 1) + "]";
+  j += ",\"wind_mean\":" + String(night.wind.mean(), 2) + ",\"wind_dir\":" + String(summaryWindDir()) + ",\"gust_max\":" + String(night.gustMax, 2);
+  j += ",\"wind_below_h\":[";
+  for (int i = 0; i < 4; i++) j += (i ? "," : "") + String(night.belowSec[i] / 3600.0, 2);
+  j += "],\"rain_mm\":" + String(night.rainMM, 1) + ",\"bat_weather_h\":" + String(night.batSec / 3600.0, 2) + ",\"cloud\":" + String(cloudCover);
+  if (night.dTemp.n) j += ",\"mast_dt\":[" + String(night.dTemp.min, 1) + "," + String(night.dTemp.mean(), 1) + "," + String(night.dTemp.max, 1) + "],\"inversion_h\":" + String(night.invSec / 3600.0, 2);
+  j += "}";
+  return j;
+}
+void writeSummaryFile() {
+  if (!sdCardOK || logFileName == "") return;
+  File f = SD.open(logFileName.substring(0, logFileName.length() - 4) + "-summary.txt", FILE_WRITE);
+  if (f) { f.print(summaryText()); f.close(); }
+}
+void saveSessionFiles() { writeGridFile(); writeRoseFile(); writeSummaryFile(); mrFlushAll(); }
+
+// Sonnenaufgang in Minuten nach 0:00 UTC (Almanac-Algorithmus, Zenit 90.833 Grad), -1 = Polartag/-nacht
+int sunriseMinutesUTC(int y, int m, int d, double lat, double lon) {
+  int N = 275 * m / 9 - ((m + 9) / 12) * (1 + (y - 4 * (y / 4) + 2) / 3) + d - 30;
+  double lngHour = lon / 15.0, t = N + (6.0 - lngHour) / 24.0, M = 0.9856 * t - 3.289;
+  double L = fmod(M + 1.916 * sin(M * DEG_TO_RAD) + 0.020 * sin(2 * M * DEG_TO_RAD) + 282.634 + 360.0, 360.0);
+  double RA = fmod(atan(0.91764 * tan(L * DEG_TO_RAD)) * RAD_TO_DEG + 360.0, 360.0);
+  RA = (RA + floor(L / 90.0) * 90.0 - floor(RA / 90.0) * 90.0) / 15.0;
+  double sinDec = 0.39782 * sin(L * DEG_TO_RAD), cosDec = cos(asin(sinDec));
+  double cosH = (cos(90.833 * DEG_TO_RAD) - sinDec * sin(lat * DEG_TO_RAD)) / (cosDec * cos(lat * DEG_TO_RAD));
+  if (cosH > 1 || cosH < -1) return -1;
+  double T = (360.0 - acos(cosH) * RAD_TO_DEG) / 15.0 + RA - 0.06571 * t - 6.622;
+  return (int)(fmod(T - lngHour + 48.0, 24.0) * 60.0 + 0.5);
+}
+
+// --- BINAER-LOG & SYNC ---
+// Parallel zur CSV wird jede Messung als Datensatz fester Groesse in <session>.bin geschrieben.
+// Datensatz n liegt damit bei Offset LOGBIN_HEADER + n * sizeof(LogRecord): ein Client mit
+// Cursor (Session-ID + Sequenznummer) bekommt per /sync nur neue Datensaetze, ohne Umweg ueber die CSV.
+#define LOGBIN_VERSION  2        // v2: Zeitstempel = Intervallmitte mit ms, Alter je Kanal
+#define LOGBIN_HEADER   16       // "NXLB", Version, Satzgroesse, 2x reserviert, Session-ID, Station-ID
+#define SYNC_MAX_BATCH  256      // Datensaetze pro /sync-Antwort (ca. 9 KB)
+#define SESSION_INDEX   "/sessions.idx"
+#define REC_FIX         0x01
+#define REC_STATIONARY  0x02
+#define REC_SYNCED      0x04
+#define REC_BME_STALE   0x08     // BME680-Lesung fehlgeschlagen, Werte aus einem frueheren Intervall
+#define REC_GPS_STALE   0x10     // Position aelter als GPS_STALE_MS (oder kein Fix)
+#define REC_TIME_RTC    0x20     // Zeitstempel von der RTC-Sekunde statt aus der GPS-Zeitbasis
+#define REC_MAST        0x40     // dTemp gueltig (zweite Messhoehe gelesen)
+#define REC_INVERSION   0x80     // oben waermer als unten (INVERSION_K, mit Hysterese)
+#define REC_DT_NONE     INT16_MIN
+struct __attribute__((packed)) LogRecord {
+  uint32_t seq, unixTime;
+  int16_t temp;           // 0.01 C
+  uint16_t hum;           // 0.01 % rH
+  uint16_t pres;          // 0.1 hPa
+  uint16_t wind, gust;    // 0.01 m/s
+  int16_t dir;            // Grad, -1 = keine Richtung
+  uint16_t rain;          // 0.01 mm im Intervall
+  int32_t lat, lon;       // 1e-7 Grad
+  uint8_t flags, cloud, sats;
+  int8_t dTemp;           // 0.1 K, oben minus unten (nur mit REC_MAST)
+  uint16_t ms;            // ms-Anteil des Zeitstempels; unixTime.ms = Mitte des Wind/Regen-Intervalls
+  uint16_t span;          // Intervalllaenge, 10 ms
+  int16_t bmeDt, gpsDt;   // Erfassung BME680 / GPS-Fix relativ zum Zeitstempel, 10 ms (REC_DT_NONE = keine)
+};
+uint32_t sessionId = 0, recordSeq = 0, stationId = 0;
+
+// CRC-32 (IEEE, wie zlib/Python binascii.crc32), Nibble-Tabelle statt 1 KB Tabelle
+PLACE_HOT const uint32_t CRC_NIBBLE[16] = { 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+                                  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+uint32_t crc32Update(uint32_t crc, const uint8_t* d, size_t n) {
+  crc = ~crc;
+  while (n--) { crc ^= *d++; crc = (crc >> 4) ^ CRC_NIBBLE[crc & 15]; crc = (crc >> 4) ^ CRC_NIBBLE[crc & 15]; }
+  return ~crc;
+}
+
+const char LOG_CSV_HEADER[] = "Date,Time,Temp,Hum,Pres,WindAvg,WindGust,WindDir,Lat,Lon,a20k_Low,a40k_Mid,a55k_High,a80k_FM,a110k_CF,u_a20k,u_a40k,u_a55k,u_a80k,u_a110k,Span,BME_dt,GPS_dt,Stale,dT_mast,Lapse,Inversion";
+
+// Dateiname aus der Session-ID (= Startzeit): "/DDMMYY-HHMM", damit auch spaeter nachgeholte
+// Daten (Flash-Ring) ihrer Session zugeordnet werden koennen
+String sessionBase(uint32_t id) {
+  DateTime t(id);
+  return "/" + pad(t.day()) + pad(t.month()) + String(t.year()).substring(2) + "-" + pad(t.hour()) + pad(t.minute());
+}
+bool ensureSessionFiles(uint32_t id) {
+  String base = sessionBase(id);
+  if (!SD.exists(base + ".csv")) { File f = SD.open(base + ".csv", FILE_WRITE); if (!f) return false; f.println(LOG_CSV_HEADER); f.close(); }
+  if (!SD.exists(base + ".bin")) {
+    uint8_t hdr[LOGBIN_HEADER] = { 'N', 'X', 'L', 'B', LOGBIN_VERSION, sizeof(LogRecord), 0, 0 };
+    memcpy(hdr + 8, &id, 4); memcpy(hdr + 12, &stationId, 4);
+    File f = SD.open(base + ".bin", FILE_WRITE); if (!f) return false; f.write(hdr, sizeof(hdr)); f.close();
+    File idx = SD.open(SESSION_INDEX, FILE_APPEND);
+    if (idx) { idx.print(String(id) + "," + base + ".bin\n"); idx.close(); }
+  }
+  return true;
+}
+int16_t recDt(uint64_t at, uint64_t ref) { int64_t d = ((int64_t)(at - ref)) / 10; return d < -32767 || d > 32767 ? REC_DT_NONE : (int16_t)d; }
+LogRecord makeLogRecord(uint64_t centreUtc, unsigned long spanMs, bool bmeFresh, float p) {
+  LogRecord r;
+  r.seq = recordSeq++; r.unixTime = centreUtc / 1000; r.ms = centreUtc % 1000; r.span = min(spanMs / 10, 65535UL);
+  r.temp = (int16_t)lroundf(bme.temperature * 100); r.hum = (uint16_t)lroundf(bme.humidity * 100); r.pres = (uint16_t)lroundf(p * 10);
+  r.wind = (uint16_t)lroundf(currentWindSpeedAverage * 100); r.gust = (uint16_t)lroundf(displayWindGust * 100); r.dir = currentWindDirDeg;
+  r.rain = (uint16_t)lroundf(intervalRainMM * 100);
+  bool fix = gps.location.isValid();
+  r.lat = fix ? (int32_t)llround(gps.location.lat() * 1e7) : 0; r.lon = fix ? (int32_t)llround(gps.location.lng() * 1e7) : 0;
+  r.bmeDt = measureTask.bmeUtc ? recDt(measureTask.bmeUtc, centreUtc) : REC_DT_NONE;
+  r.gpsDt = fix ? recDt(utcMs(millis() - gps.location.age() * SOAK_SPEED), centreUtc) : REC_DT_NONE;
+  r.flags = (fix ? REC_FIX : 0) | (isStationary ? REC_STATIONARY : 0) | (timeSynced ? REC_SYNCED : 0) | (bmeFresh ? 0 : REC_BME_STALE)
+    | (!fix || gps.location.age() * SOAK_SPEED > GPS_STALE_MS ? REC_GPS_STALE : 0) | (tbGps ? 0 : REC_TIME_RTC)
+    | (mastValid ? REC_MAST : 0) | (mastValid && mastInv ? REC_INVERSION : 0);
+  r.cloud = cloudCover; r.sats = gps.satellites.value(); r.dTemp = mastValid ? (int8_t)constrain(lroundf(mastDT * 10), -127L, 127L) : 0;
+  return r;
+}
+// --- HASH-KETTE (MANIPULATIONSSCHUTZ) ---
+// Die Datensaetze in <session>.bin werden in Bloecken zu CHAIN_BLOCK verkettet:
+//   h0 = SHA256(.bin-Header), hb = SHA256(h(b-1) || Datensaetze des Blocks b)
+// Jeder Block haengt einen ChainEntry an <session>.chain an. Bei Sessionende wird der Rest-Block
+// geschrieben und der Kettenkopf mit HMAC-SHA256 (SECRET_LOG_KEY) in <session>.sig signiert.
+// SHA-256 laeuft ueber mbedtls und damit auf dem SHA-Beschleuniger des ESP32-S3.
+// Nach einem Neustart wird die Kette aus .chain und den noch nicht verketteten .bin-Saetzen fortgesetzt.
+#define CHAIN_BLOCK 16           // Datensaetze pro Block (ca. 2 min)
+#define CHAIN_SEAL_RETRY 5000    // ms zwischen Siegelversuchen, solange .sig nicht geschrieben ist
+struct __attribute__((packed)) ChainEntry { uint32_t first; uint16_t count, reserved; uint8_t hash[32]; };   // first = Satzindex in .bin, nicht r.seq
+struct __attribute__((packed)) ChainSig { char magic[4]; uint8_t version, keyed, res[2]; uint32_t session, station, records; uint8_t head[32], hmac[32]; };
+struct ChainState {
+  uint32_t session, nextIdx, blocks; uint16_t n; bool ok;   // nextIdx: naechster Satzindex in .bin
+  uint8_t head[32]; LogRecord block[CHAIN_BLOCK];
+} chain;
+uint32_t chainSealPending = 0; unsigned long lastChainSeal = 0;
+
+void sha256Chain(const uint8_t prev[32], const uint8_t* data, size_t len, uint8_t out[32]) {
+  mbedtls_md_context_t c; mbedtls_md_init(&c);
+  mbedtls_md_setup(&c, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+  mbedtls_md_starts(&c);
+  if (prev) mbedtls_md_update(&c, prev, 32);
+  mbedtls_md_update(&c, data, len);
+  mbedtls_md_finish(&c, out); mbedtls_md_free(&c);
+}
+String hexBytes(const uint8_t* b, int n) { String h; char t[3]; for (int i = 0; i < n; i++) { snprintf(t, sizeof(t), "%02x", b[i]); h += t; } return h; }
+String chainHeadHex(int n) { return hexBytes(chain.head, n); }
+// Offenen Block abschliessen und als ChainEntry anhaengen
+bool chainFlush() {
+  if (!chain.n) return true;
+  ChainEntry e = { chain.nextIdx - chain.n, chain.n, 0, {} };
+  sha256Chain(chain.head, (const uint8_t*)chain.block, chain.n * sizeof(LogRecord), e.hash);
+  File f = SD.open(sessionBase(chain.session) + ".chain", FILE_APPEND);
+  if (!f || f.write((const uint8_t*)&e, sizeof(e)) != sizeof(e)) { if (f) f.close(); chain.ok = false; return false; }
+  f.close();
+  memcpy(chain.head, e.hash, 32); chain.n = 0; chain.blocks++;
+  return true;
+}
+void chainAdd(const LogRecord &r) {
+  chain.block[chain.n++] = r; chain.nextIdx++;
+  if (chain.n == CHAIN_BLOCK) chainFlush();
+}
+// Kette einer Session laden: letzter Eintrag aus .chain (oder Header-Hash), dann .bin-Rest einlesen
+bool chainOpen(uint32_t sid) {
+  if (chain.session == sid && chain.ok) return true;
+  memset(&chain, 0, sizeof(chain)); chain.session = sid; chain.ok = true;
+  String base = sessionBase(sid);
+  File b = SD.open(base + ".bin", FILE_READ); if (!b) { chain.ok = false; return false; }
+  uint8_t hdr[LOGBIN_HEADER];
+  if (b.read(hdr, sizeof(hdr)) != sizeof(hdr)) { b.close(); chain.ok = false; return false; }
+  sha256Chain(nullptr, hdr, sizeof(hdr), chain.head);
+  File c = SD.open(base + ".chain", FILE_READ);
+  if (c) {
+    size_t n = c.size() / sizeof(ChainEntry); ChainEntry e;
+    if (n && c.seek((n - 1) * sizeof(ChainEntry)) && c.read((uint8_t*)&e, sizeof(e)) == sizeof(e)) { memcpy(chain.head, e.hash, 32); chain.nextIdx = e.first + e.count; chain.blocks = n; }
+    c.close();
+  }
+  LogRecord r;
+  if (b.seek(LOGBIN_HEADER + chain.nextIdx * sizeof(LogRecord)))
+    while (b.read((uint8_t*)&r, sizeof(r)) == sizeof(r)) chainAdd(r);
+  b.close();
+  return chain.ok;
+}
+// Aus appendToSD: Datensatz steht schon an Index idx in .bin, also beim Fortsetzen evtl. bereits eingelesen
+void chainAppend(uint32_t sid, uint32_t idx, const LogRecord &r) {
+  if (!chainOpen(sid) || idx < chain.nextIdx) return;
+  chainAdd(r);
+}
+// Sessionende: Rest-Block schreiben, Kopf signieren. loop() ruft das erst, wenn SD bereit ist und
+// keine Ring-Daten mehr ausstehen (sonst fehlten sie in der Kette). Offen bleibt das Siegel, bis .sig
+// tatsaechlich geschrieben ist; loop() versucht es dann alle CHAIN_SEAL_RETRY ms erneut.
+bool chainSeal(uint32_t sid) {
+  if (!chainOpen(sid) || !chainFlush()) return false;
+  ChainSig g = { { 'N', 'X', 'S', 'G' }, 1, 0, { 0, 0 }, sid, stationId, chain.nextIdx, {}, {} };
+  memcpy(g.head, chain.head, 32);
+  const char* key = SECRET_LOG_KEY;
+  if (*key) { g.keyed = 1; mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const uint8_t*)key, strlen(key), (const uint8_t*)&g, offsetof(ChainSig, hmac), g.hmac); }
+  File f = SD.open(sessionBase(sid) + ".sig", FILE_WRITE); if (!f) return false;
+  bool ok = f.write((const uint8_t*)&g, sizeof(g)) == sizeof(g); f.close();
+  if (ok && chainSealPending == sid) chainSealPending = 0;
+  return ok;
+}
+void handleChain() {
+  String j = "{\"session\":" + String(chain.session) + ",\"records\":" + String(chain.nextIdx) + ",\"blocks\":" + String(chain.blocks) + ",\"open\":" + String(chain.n);
+  j += ",\"ok\":" + String(chain.ok ? "true" : "false") + ",\"head\":\"" + hexBytes(chain.head, 32) + "\",\"seal_pending\":" + String(chainSealPending ? "true" : "false") + "}";
+  server.send(200, "application/json", j);
+}
+
+// --- CSV-FORMATIERER OHNE PRINTF ---
+// Der Datensatz liegt schon als skalierte Ganzzahlen vor, also braucht die Log-Zeile keine
+// Fliesskomma-Formatierung: Ziffernpaare aus einer Tabelle, Nachkommastellen per Ganzzahl-Division.
+// Das ist exakt (keine Binaer-Rundung wie bei %.1f) und deutlich schneller als newlib-printf.
+PLACE_HOT const char DIGIT_PAIRS[201] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+#define CSV_ROW_MAX 256
+
+inline char* put2(char* p, uint32_t v) { memcpy(p, DIGIT_PAIRS + 2 * v, 2); return p + 2; }
+char* putUInt(char* p, uint32_t v) {
+  char tmp[10]; char* t = tmp + sizeof(tmp);
+  while (v >= 100) { t -= 2; memcpy(t, DIGIT_PAIRS + 2 * (v % 100), 2); v /= 100; }
+  if (v >= 10) { t -= 2; memcpy(t, DIGIT_PAIRS + 2 * v, 2); } else *--t = '0' + v;
+  size_t n = tmp + sizeof(tmp) - t; memcpy(p, t, n); return p + n;
+}
+char* putInt(char* p, int32_t v) { if (v < 0) { *p++ = '-'; return putUInt(p, (uint32_t)(-(int64_t)v)); } return putUInt(p, v); }
+// v ist mit 10^dec skaliert: putFixed(p, 1534, 2) -> "15.34", putFixed(p, -5, 2) -> "-0.05"
+char* putFixed(char* p, int32_t v, int dec) {
+  static const uint32_t POW10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+  uint32_t a = v < 0 ? (uint32_t)(-(int64_t)v) : v, q = a / POW10[dec], r = a % POW10[dec];
+  if (v < 0) *p++ = '-';
+  p = putUInt(p, q); *p++ = '.';
+  for (int i = dec - 1; i >= 0; i--) { p[i] = '0' + r % 10; r /= 10; }
+  return p + dec;
+}
+inline int32_t roundDiv(int32_t v, int32_t d) { return (v >= 0 ? v + d / 2 : v - d / 2) / d; }
+
+// Daempfung +- Unsicherheit je Band in mdB/m, so wie sie in der CSV steht. Wird einmal je Zyklus aus den
+// gerundeten Werten des Datensatzes berechnet und reist mit ihm (auch durch den Flash-Ring), damit die
+// CSV-Zeile keine ISO-Auswertung mehr braucht und Ring-Nachtraege gleich aussehen.
+struct __attribute__((packed)) AlphaRow { uint16_t a[5], u[5]; };
+AlphaRow alphaRow(const float a[5], const float u[5]) {
+  AlphaRow ab; for (int i = 0; i < 5; i++) { ab.a[i] = lroundf(a[i] * 1000); ab.u[i] = lroundf(u[i] * 1000); }
+  return ab;
+}
+// CSV-Zeile wird aus dem Datensatz erzeugt: identisch fuer Live-Log und nachgeholte Ring-Daten
+int formatCSVRow(const LogRecord &r, const AlphaRow &ab, char* buf, size_t len) {
+  if (len < CSV_ROW_MAX) return 0;
+  DateTime t(r.unixTime); char* p = buf;
+  p = put2(p, t.day()); *p++ = '.'; p = put2(p, t.month()); *p++ = '.'; p = putUInt(p, t.year()); *p++ = ',';
+  p = put2(p, t.hour()); *p++ = ':'; p = put2(p, t.minute()); *p++ = ':'; p = put2(p, t.second()); *p++ = '.'; *p++ = '0' + r.ms / 100; p = put2(p, r.ms % 100); *p++ = ',';
+  p = putFixed(p, r.temp, 2); *p++ = ','; p = putFixed(p, roundDiv(r.hum, 10), 1); *p++ = ','; p = putFixed(p, r.pres, 1); *p++ = ',';
+  p = putFixed(p, r.wind, 2); *p++ = ','; p = putFixed(p, r.gust, 2); *p++ = ','; p = putInt(p, r.dir); *p++ = ',';
+  p = putFixed(p, roundDiv(r.lat, 10), 6); *p++ = ','; p = putFixed(p, roundDiv(r.lon, 10), 6);
+  for (int i = 0; i < 5; i++) { *p++ = ','; p = putFixed(p, ab.a[i], 3); }
+  for (int i = 0; i < 5; i++) { *p++ = ','; p = putFixed(p, ab.u[i], 3); }
+  // Intervalllaenge und Alter je Kanal in s relativ zum Zeitstempel (leer = nie erfasst), Stale: B/G/T
+  *p++ = ','; p = putFixed(p, r.span, 2);
+  *p++ = ','; if (r.bmeDt != REC_DT_NONE) p = putFixed(p, r.bmeDt, 2);
+  *p++ = ','; if (r.gpsDt != REC_DT_NONE) p = putFixed(p, r.gpsDt, 2);
+  *p++ = ','; if (r.flags & REC_BME_STALE) *p++ = 'B'; if (r.flags & REC_GPS_STALE) *p++ = 'G'; if (r.flags & REC_TIME_RTC) *p++ = 'T';
+  // Zweite Messhoehe: dT in K, Gradient in K/100 m, Inversion 0/1 (leer = kein oberer Sensor)
+  *p++ = ','; if (r.flags & REC_MAST) p = putFixed(p, r.dTemp, 1);
+  *p++ = ','; if (r.flags & REC_MAST) p = putFixed(p, lroundf(r.dTemp * 1000.0f / (MAST_HIGH_M - MAST_LOW_M)), 2);
+  *p++ = ','; if (r.flags & REC_MAST) *p++ = r.flags & REC_INVERSION ? '1' : '0';
+  *p++ = '\n';
+  return p - buf;
+}
+uint32_t sdAppended = 0;   // erfolgreich geschriebene Datensaetze (MQTT schaut nur nach, wenn sich hier etwas tut)
+// Erst .bin (Grundlage fuer Kette, Sync und MQTT) samt Kettenglied, dann die CSV-Zeile. Scheitert nur die
+// CSV, steht der Satz schon in .bin: der Nachtrag aus dem Ring (replay) erkennt ihn als letzten Satz dort
+// und schreibt nur noch die CSV-Zeile, statt ihn ein zweites Mal (mit verschobenem Kettenindex) anzuhaengen.
+bool appendToSD(uint32_t sid, const LogRecord &r, const AlphaRow &ab, bool replay = false) {
+  if (FAULT(FAULT_SD_FAIL)) return false;
+  FAULT_DELAY(FAULT_SD_SLOW);
+  String base = sessionBase(sid); size_t pos = 0; bool inBin = false;
+  if (replay) {
+    File c = SD.open(base + ".bin", FILE_READ); if (!c) return false;
+    LogRecord last; pos = c.size();
+    inBin = pos >= LOGBIN_HEADER + sizeof(r) && c.seek(pos - sizeof(r)) && c.read((uint8_t*)&last, sizeof(last)) == sizeof(last) && !memcmp(&last, &r, sizeof(r));
+    c.close();
+    if (inBin) pos -= sizeof(r);
+  }
+  if (!inBin) {
+    File b = SD.open(base + ".bin", FILE_APPEND); if (!b) return false;
+    pos = b.size();
+    bool ok = b.write((const uint8_t*)&r, sizeof(r)) == sizeof(r); b.close();
+    if (!ok) return false;
+    sdAppended++;
+  }
+  if (pos >= LOGBIN_HEADER) chainAppend(sid, (pos - LOGBIN_HEADER) / sizeof(r), r);
+  char line[CSV_ROW_MAX]; int n = formatCSVRow(r, ab, line, sizeof(line));
+  File f = SD.open(base + ".csv", FILE_APPEND); if (!f) return false;
+  bool ok = f.write((const uint8_t*)line, n) == (size_t)n; f.close();
+  return ok;
+}
+String findSessionFile(uint32_t id) { String n = sessionBase(id) + ".bin"; return SD.exists(n) ? n : String(""); }
+void handleSyncSessions() {
+  String j = "{\"station\":" + String(stationId) + ",\"current\":" + String(sessionId) + ",\"rec_size\":" + String(sizeof(LogRecord)) + ",\"sessions\":[";
+  File idx = SD.open(SESSION_INDEX, FILE_READ); bool first = true;
+  while (sdCardOK && idx && idx.available()) {
+    String line = idx.readStringUntil('\n'); int c = line.indexOf(',');
+    if (c <= 0) continue;
+    File b = SD.open(line.substring(c + 1), FILE_READ); uint8_t hdr[6] = { 0 };   // aeltere Sessions koennen eine andere Satzgroesse haben
+    uint32_t n = (b && b.size() >= LOGBIN_HEADER && b.read(hdr, 6) == 6 && hdr[5]) ? (b.size() - LOGBIN_HEADER) / hdr[5] : 0;
+    if (b) b.close();
+    j += (first ? "" : ",") + String("{\"id\":") + line.substring(0, c) + ",\"file\":\"" + line.substring(c + 1) + "\",\"records\":" + String(n) + ",\"rec_size\":" + String(hdr[5]) + "}";
+    first = false;
+  }
+  if (idx) idx.close();
+  server.send(200, "application/json", j + "]}");
+}
+// GET /sync?session=<id>&seq=<n>&max=<k>
+// Antwort: "NXSB", Version, Satzgroesse, Anzahl (u16), Station-ID, Session-ID, erste Seq, Gesamtzahl (u32),
+// dann <Anzahl> Datensaetze, zuletzt CRC-32 ueber alles davor. Alle Werte little endian.
+void handleSync() {
+  uint32_t id = server.hasArg("session") ? strtoul(server.arg("session").c_str(), nullptr, 10) : sessionId;
+  uint32_t seq = server.hasArg("seq") ? strtoul(server.arg("seq").c_str(), nullptr, 10) : 0;
+  uint32_t maxN = server.hasArg("max") ? strtoul(server.arg("max").c_str(), nullptr, 10) : SYNC_MAX_BATCH;
+  if (maxN == 0 || maxN > SYNC_MAX_BATCH) maxN = SYNC_MAX_BATCH;
+  String name = sdCardOK ? findSessionFile(id) : "";
+  File f = name != "" ? SD.open(name, FILE_READ) : File();
+  if (name == "" || !f) { server.send(404, "text/plain", "UNKNOWN SESSION"); return; }
+  uint8_t fh[6] = { 0 };
+  if (f.read(fh, 6) != 6 || fh[5] != sizeof(LogRecord)) { f.close(); server.send(409, "text/plain", "OLD RECORD FORMAT"); return; }
+  IoLease io(ioPool);
+  if (!io) { f.close(); server.send(503, "text/plain", "BUSY"); return; }
+  uint32_t total = f.size() >= LOGBIN_HEADER ? (f.size() - LOGBIN_HEADER) / sizeof(LogRecord) : 0;
+  uint16_t count = seq < total ? (uint16_t)min(total - seq, maxN) : 0;
+  uint8_t hdr[24] = { 'N', 'X', 'S', 'B', LOGBIN_VERSION, sizeof(LogRecord) };
+  memcpy(hdr + 6, &count, 2); memcpy(hdr + 8, &stationId, 4); memcpy(hdr + 12, &id, 4); memcpy(hdr + 16, &seq, 4); memcpy(hdr + 20, &total, 4);
+  uint32_t crc = crc32Update(0, hdr, sizeof(hdr));
+  server.setContentLength(sizeof(hdr) + (size_t)count * sizeof(LogRecord) + 4);
+  server.send(200, "application/octet-stream", "");
+  server.sendContent((const char*)hdr, sizeof(hdr));
+  uint8_t* buf = io->b;
+  f.seek(LOGBIN_HEADER + seq * sizeof(LogRecord));
+  for (uint32_t left = (uint32_t)count * sizeof(LogRecord); left > 0; ) {
+    size_t n = f.read(buf, min((uint32_t)sizeof(io->b), left));
+    if (n == 0) break;   // Kurze Antwort: der Client verwirft den Batch (Laenge/CRC)
+    crc = crc32Update(crc, buf, n); server.sendContent((const char*)buf, n); left -= n;
+  }
+  f.close();
+  server.sendContent((const char*)&crc, 4);
+}
+
+// --- MULTI-RATE-LOG ---
+// Jeder Kanal in seiner eigenen Rate statt alles im 8-s-Raster: Wind/Richtung je Sekunde, GPS je Fix
+// (stationaer jede Minute), BME680 je Messung (Zeit = Messbeginn auf dem 8-s-Raster), Regen je Sekunde
+// mit Kippung, Gaswiderstand/IAQ je Heiztermin, zweite Messhoehe je Messung. <session>.nxm: Kopf mit Kanalbeschreibung (Name, Raster, Felder als Struct-Code:Skala),
+// dann Bloecke eines Kanals (Startzeit UTC-ms, festes Raster oder ms-Abstaende, CRC-32), bei Sessionende
+// Index + Fusszeile. Ohne Index (Stromausfall) liest der Host die Bloecke der Reihe nach.
+// Nur auf SD: faellt die Karte aus, fehlen hier Bloecke (die 8-s-Datensaetze laufen ueber den Ring).
+#define MR_VERSION     1
+#define MR_BLOCK_MAX   128          // Proben je Block (Wind: ca. 2 min)
+#define MR_REC_MAX     11
+#define MR_INDEX_MAX   4096
+#define MR_BLOCK_MAGIC 0x4B42       // "BK"
+struct MrDesc { uint8_t recSize; uint16_t periodMs; const char* name; const char* fields; };   // periodMs 0 = unregelmaessig
+const MrDesc MR_DESC[MR_STREAMS] = {
+  { 4, 1000, "wind", "speed:H:0.01,dir:h:1" },
+  { 6, LOG_INTERVAL_MS, "bme", "temp:h:0.01,hum:H:0.01,pres:H:0.1" },
+  { 11, 1000, "gps", "lat:i:1e-7,lon:i:1e-7,alt:h:0.1,sats:B:1" },
+  { 1, 0, "rain", "tips:B:1" },
+  { 6, 0, "gas", "ohm:I:1,iaq:H:0.1" },
+  { 7, LOG_INTERVAL_MS, "mast", "t:h:0.01,rh:H:0.01,lapse:h:0.01,inv:B:1" },
+  { 10, LOG_INTERVAL_MS, "dalpha", "da20:h:1,da40:h:1,da55:h:1,da80:h:1,da110:h:1" },
+};
+struct __attribute__((packed)) MrBlockHdr { uint16_t magic; uint8_t stream, irregular; uint16_t n, dtMs; uint64_t t0; };
+struct __attribute__((packed)) MrIndexEntry { uint8_t stream, pad; uint16_t n; uint32_t offset; uint64_t t0; };
+struct MrBuf { uint64_t t0, last; uint16_t n, dtMs; uint16_t delta[MR_BLOCK_MAX]; uint8_t data[MR_BLOCK_MAX * MR_REC_MAX]; };
+MrBuf* mrBuf = nullptr; MrIndexEntry* mrIndex = nullptr;   // PSRAM
+uint32_t mrSession = 0, mrSize = 0, mrIndexN = 0, mrBlocks = 0, mrDropped = 0; bool mrOk = false;
+void mrBegin() { mrBuf = (MrBuf*)bulkCalloc(MR_STREAMS, sizeof(MrBuf)); mrIndex = (MrIndexEntry*)bulkCalloc(MR_INDEX_MAX, sizeof(MrIndexEntry)); }
+void mrIndexAdd(const MrBlockHdr &h, uint32_t off) { if (mrIndexN < MR_INDEX_MAX) mrIndex[mrIndexN++] = { h.stream, 0, h.n, off, h.t0 }; }
+size_t mrPayload(const MrBlockHdr &h) { return h.n * ((h.irregular ? 2 : 0) + MR_DESC[h.stream].recSize); }
+// Neue Datei: Kopf schreiben. Vorhandene (Neustart in der Session): Bloecke lesen und Index neu aufbauen.
+bool mrOpen(uint32_t sid) {
+  if (mrSession == sid) return mrOk;
+  mrSession = sid; mrOk = false; mrIndexN = 0;
+  for (int i = 0; i < MR_STREAMS; i++) mrBuf[i].n = 0;
+  String name = sessionBase(sid) + ".nxm";
+  if (!SD.exists(name)) {
+    File f = SD.open(name, FILE_WRITE); if (!f) return false;
+    uint8_t hdr[16] = { 'N', 'X', 'M', 'R', MR_VERSION, MR_STREAMS, 0, 0 }; memcpy(hdr + 8, &sid, 4); memcpy(hdr + 12, &stationId, 4);
+    f.write(hdr, sizeof(hdr));
+    for (int i = 0; i < MR_STREAMS; i++) {   // 60 Byte je Kanal: ID, Satzgroesse, Raster, Name[8], Felder[48]
+      uint8_t d[60] = { (uint8_t)i, MR_DESC[i].recSize }; memcpy(d + 2, &MR_DESC[i].periodMs, 2);
+      strncpy((char*)d + 4, MR_DESC[i].name, 8); strncpy((char*)d + 12, MR_DESC[i].fields, 48); f.write(d, sizeof(d));
+    }
+    mrSize = f.size(); f.close(); return mrOk = true;
+  }
+  File f = SD.open(name, FILE_READ); if (!f) return false;
+  uint32_t off = 16 + 60 * MR_STREAMS; MrBlockHdr h;
+  while (f.seek(off) && f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == MR_BLOCK_MAGIC && h.stream < MR_STREAMS) {
+    mrIndexAdd(h, off); off += sizeof(h) + mrPayload(h) + 4;
+  }
+  mrSize = f.size(); f.close();   // ein halb geschriebener letzter Block bleibt stehen, der Host ueberspringt ihn per CRC
+  return mrOk = true;
+}
+void mrFlush(MrStream s) {
+  MrBuf &b = mrBuf[s];
+  if (!b.n) return;
+  if (!sdCardOK || !mrOpen(sessionId)) { mrDropped += b.n; b.n = 0; return; }
+  MrBlockHdr h = { MR_BLOCK_MAGIC, (uint8_t)s, (uint8_t)(MR_DESC[s].periodMs ? 0 : 1), b.n, b.dtMs, b.t0 };
+  uint32_t crc = crc32Update(0, (const uint8_t*)&h, sizeof(h));
+  if (h.irregular) crc = crc32Update(crc, (const uint8_t*)b.delta, b.n * 2);
+  crc = crc32Update(crc, b.data, b.n * MR_DESC[s].recSize);
+  File f = SD.open(sessionBase(sessionId) + ".nxm", FILE_APPEND);
+  bool ok = f && f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h) && (!h.irregular || f.write((const uint8_t*)b.delta, b.n * 2) == b.n * 2u)
+    && f.write(b.data, b.n * MR_DESC[s].recSize) == b.n * MR_DESC[s].recSize && f.write((const uint8_t*)&crc, 4) == 4;
+  if (f) f.close();
+  if (ok) { mrIndexAdd(h, mrSize); mrSize += sizeof(h) + mrPayload(h) + 4; mrBlocks++; } else { mrDropped += b.n; mrOk = false; mrSession = 0; }
+  b.n = 0;
+}
+void mrFlushAll() { if (mrBuf) for (int i = 0; i < MR_STREAMS; i++) mrFlush((MrStream)i); }
+// Regelmaessige Kanaele: Block endet bei einer Luecke im Raster (t != t0 + n * dt) oder wenn er voll ist
+void mrPut(MrStream s, uint64_t t, const void* rec) {
+  if (!mrBuf || appState != 2) return;
+  MrBuf &b = mrBuf[s]; uint16_t dt = s == MR_GPS && isStationary ? 60000 : MR_DESC[s].periodMs;
+  if (b.n && t <= b.last) return;   // gleiche Sekunde (z. B. RMC und GGA)
+  if (b.n && (b.n == MR_BLOCK_MAX || (dt ? (b.dtMs != dt || t != b.t0 + (uint64_t)b.n * dt) : t - b.last > 65535))) mrFlush(s);
+  if (!b.n) { b.t0 = t; b.dtMs = dt; }
+  if (!dt) b.delta[b.n] = b.n ? t - b.last : 0;
+  memcpy(b.data + b.n * MR_DESC[s].recSize, rec, MR_DESC[s].recSize);
+  b.last = t; b.n++;
+}
+// GPS je neuem Fix, Zeit = Fixzeit auf die Sekunde; stationaer nur zur vollen Minute
+void mrGpsSample() {
+  if (!gps.location.isUpdated() || !tbGps) return;
+  uint64_t t = (uint64_t)tbUnix * 1000;   // lat() setzt isUpdated() zurueck
+  if (isStationary && t % 60000) return;
+  struct __attribute__((packed)) { int32_t lat, lon; int16_t alt; uint8_t sats; } g = {
+    (int32_t)lround(gps.location.lat() * 1e7), (int32_t)lround(gps.location.lng() * 1e7),
+    (int16_t)constrain(lround(gps.altitude.meters() * 10), -32768L, 32767L), (uint8_t)min(gps.satellites.value(), (uint32_t)255) };
+  mrPut(MR_GPS, t, &g);
+}
+// Sessionende: Rest-Bloecke, dann Index ("NXIX", Anzahl, Eintraege) und Fusszeile (Index-Offset, "NXIE")
+void mrClose() {
+  mrFlushAll();
+  if (mrOk && mrSession == sessionId && sdCardOK) {
+    File f = SD.open(sessionBase(sessionId) + ".nxm", FILE_APPEND);
+    if (f) {
+      f.write((const uint8_t*)"NXIX", 4); f.write((const uint8_t*)&mrIndexN, 4); f.write((const uint8_t*)mrIndex, mrIndexN * sizeof(MrIndexEntry));
+      f.write((const uint8_t*)&mrSize, 4); f.write((const uint8_t*)"NXIE", 4); f.close();
+    }
+  }
+  mrSession = 0; mrOk = false;
+}
+
+// --- FLASH-RINGPUFFER (SD-AUSFALL) ---
+// Faellt die SD-Karte aus (beim Start oder mitten in der Nacht), landen die Datensaetze in einem
+// Ring im internen Flash (SPIFFS-Datenpartition, roh beschrieben, kein Dateisystem). Jeder Slot
+// wird genau einmal programmiert, Sektoren werden reihum geloescht -> gleichmaessiger Verschleiss
+// und kaum Schreibverstaerkung. Ist die Karte wieder da, wandern die Daten in Reihenfolge auf die
+// SD (CSV + .bin) und werden im Flash nur als uebertragen markiert (Bit 1 -> 0, ohne Loeschen).
+#define RING_BYTES          (512 * 1024)   // 4096 Slots = ca. 9 h bei 8 s Intervall
+#define RING_SLOT           128
+#define RING_SECTOR         4096
+#define RING_MAGIC          0x4E585232     // "NXR2" (mit Baendern; alte "NXRS"-Slots werden ignoriert)
+#define RING_PENDING        0xFF
+#define RING_DONE           0x00
+#define RING_MIGRATE_BATCH  64             // Slots pro loop()-Durchlauf
+#define SD_RETRY_INTERVAL   30000
+struct __attribute__((packed)) RingSlot {
+  uint32_t magic, ringSeq, session;
+  LogRecord rec;
+  AlphaRow alpha;
+  uint8_t state;
+  uint8_t pad[RING_SLOT - 12 - sizeof(LogRecord) - sizeof(AlphaRow) - 1 - 4];
+  uint32_t crc;            // ueber magic..alpha (state bleibt aussen vor, wird nachtraeglich markiert)
+};
+static_assert(sizeof(RingSlot) == RING_SLOT, "RingSlot muss genau einen Slot fuellen");
+const esp_partition_t* ringPart = nullptr;
+uint32_t ringSlots = 0, ringHead = 0, ringTail = 0, ringNextSeq = 0, ringPending = 0;
+uint32_t ringOverwritten = 0, ringMigrated = 0, ringErases = 0, sdFailures = 0;
+uint64_t ringPayloadBytes = 0, ringFlashBytes = 0;
+unsigned long lastSdRetry = 0;
+
+uint32_t ringSlotCRC(const RingSlot &s) { return crc32Update(0, (const uint8_t*)&s, offsetof(RingSlot, state)); }
+bool ringRead(uint32_t i, RingSlot &s) {
+  return esp_partition_read(ringPart, (size_t)i * RING_SLOT, &s, sizeof(s)) == ESP_OK && s.magic == RING_MAGIC && s.crc == ringSlotCRC(s);
+}
+// Beim Start: Kopf (hinter dem juengsten Slot) und aeltesten offenen Slot suchen
+bool ringBegin() {
+  ringPart = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+  if (!ringPart) return false;
+  ringSlots = (min((uint32_t)RING_BYTES, (uint32_t)ringPart->size) / RING_SECTOR) * (RING_SECTOR / RING_SLOT);
+  uint32_t maxSeq = 0, minPending = UINT32_MAX; bool any = false; RingSlot s;
+  for (uint32_t i = 0; i < ringSlots; i++) {
+    if (!ringRead(i, s)) continue;
+    if (!any || s.ringSeq >= maxSeq) { maxSeq = s.ringSeq; ringHead = (i + 1) % ringSlots; any = true; }
+    if (s.state == RING_PENDING) { ringPending++; if (s.ringSeq < minPending) { minPending = s.ringSeq; ringTail = i; } }
+  }
+  ringNextSeq = any ? maxSeq + 1 : 0;
+  // Stromausfall mitten im Schreiben hinterlaesst einen halb programmierten Slot: ueberspringen
+  uint32_t m = 0;
+  while (ringHead % (RING_SECTOR / RING_SLOT) && esp_partition_read(ringPart, (size_t)ringHead * RING_SLOT, &m, 4) == ESP_OK && m != 0xFFFFFFFF) ringHead = (ringHead + 1) % ringSlots;
+  if (!ringPending) ringTail = ringHead;
+  return true;
+}
+bool ringAppend(uint32_t sid, const LogRecord &r, const AlphaRow &ab) {
+  if (!ringPart) return false;
+  const uint32_t perSector = RING_SECTOR / RING_SLOT;
+  if (ringHead % perSector == 0) {   // naechster Sektor: loeschen, dort noch offene (aelteste) Daten gehen verloren
+    RingSlot old;
+    for (uint32_t i = ringHead; i < ringHead + perSector; i++) if (ringRead(i, old) && old.state == RING_PENDING) { ringPending--; ringOverwritten++; }
+    if (esp_partition_erase_range(ringPart, (size_t)ringHead * RING_SLOT, RING_SECTOR) != ESP_OK) return false;
+    ringErases++; ringFlashBytes += RING_SECTOR;
+    if (ringPending && ringTail >= ringHead && ringTail < ringHead + perSector) ringTail = (ringHead + perSector) % ringSlots;
+  }
+  RingSlot s; memset(&s, 0xFF, sizeof(s));
+  s.magic = RING_MAGIC; s.ringSeq = ringNextSeq++; s.session = sid; s.rec = r; s.alpha = ab; s.crc = ringSlotCRC(s);
+  if (esp_partition_write(ringPart, (size_t)ringHead * RING_SLOT, &s, sizeof(s)) != ESP_OK) return false;
+  if (!ringPending) ringTail = ringHead;
+  ringHead = (ringHead + 1) % ringSlots; ringPending++;
+  ringPayloadBytes += sizeof(LogRecord); ringFlashBytes += RING_SLOT;
+  return true;
+}
+// Offene Slots in Schreibreihenfolge auf die SD uebertragen (portionsweise, damit loop() frei bleibt)
+void ringMigrate() {
+  if (!ringPart || !sdCardOK || !ringPending) return;
+  RingSlot s; uint32_t lastSession = 0;
+  for (int n = 0; n < RING_MIGRATE_BATCH && ringPending && ringTail != ringHead; n++, ringTail = (ringTail + 1) % ringSlots) {
+    if (!ringRead(ringTail, s) || s.state != RING_PENDING) continue;
+    if (s.session != lastSession) { if (!ensureSessionFiles(s.session)) { sdCardOK = false; sdFailures++; return; } lastSession = s.session; }
+    if (!appendToSD(s.session, s.rec, s.alpha, true)) { sdCardOK = false; sdFailures++; return; }
+    uint8_t done = RING_DONE;
+    esp_partition_write(ringPart, (size_t)ringTail * RING_SLOT + offsetof(RingSlot, state), &done, 1);
+    ringPending--; ringMigrated++;
+  }
+  if (!ringPending) ringTail = ringHead;
+}
+// Ein Datensatz der laufenden Session: direkt auf SD, solange dort nichts aus dem Ring aussteht
+bool storeRecord(const LogRecord &r, const AlphaRow &ab) {
+  if (sdCardOK && !ringPending) {
+    if (appendToSD(sessionId, r, ab)) return true;
+    sdCardOK = false; sdFailures++;
+  }
+  return ringAppend(sessionId, r, ab);
+}
+void sdRetry() {
+  if (sdCardOK || millis() - lastSdRetry < SD_RETRY_INTERVAL) return;
+  lastSdRetry = millis();
+  SD.end(); sdCardOK = !FAULT(FAULT_SD_FAIL) && SD.begin(PIN_SD_CS);
+  if (sdCardOK && appState >= 2 && sessionId) sdCardOK = ensureSessionFiles(sessionId);
+}
+void handleStorage() {
+  String j = "{\"sd\":" + String(sdCardOK ? "true" : "false") + ",\"sd_failures\":" + String(sdFailures) + ",\"ring\":" + String(ringPart ? "true" : "false");
+  j += ",\"ring_slots\":" + String(ringSlots) + ",\"ring_pending\":" + String(ringPending) + ",\"ring_migrated\":" + String(ringMigrated) + ",\"ring_overwritten\":" + String(ringOverwritten);
+  j += ",\"ring_erases\":" + String(ringErases) + ",\"write_amp\":" + String(ringPayloadBytes ? (double)ringFlashBytes / ringPayloadBytes : 0.0, 2) + "}";
+  server.send(200, "application/json", j);
+}
+
+// --- SESSION ---
+void startSession() {
+  DateTime now = rtc.now();
+  sessionId = now.unixtime(); recordSeq = 0;
+  logFileName = sessionBase(sessionId) + ".csv";
+  if (sdCardOK && !ensureSessionFiles(sessionId)) { sdCardOK = false; sdFailures++; }
+  roseReset(); summaryReset(sessionId); gridReset(); windReset();
+  lastRoseSample = lastSessionSave = sessionStartMillis = lastLogCheck = millis();
+  roseNextUtc = (utcMs(lastRoseSample) / 1000 + 2) * 1000; roseEpoch = tbEpoch;   // erste Probe auf voller UTC-Sekunde, 1-2 s nach dem Start
+  TASK_RESTART(measureTask);
+  oledWake(); oledVer = UINT32_MAX;
+  sunriseDay = -1; lastDayMin = -1;
+}
+void endSession(const char* reason) {
+  night.endUnix = rtc.now().unixtime(); night.endReason = reason;
+  saveSessionFiles(); mrClose(); chainSealPending = sessionId;
+  appState = 3; buttonReleased = false; oledWake();
+}
+// Sonnenaufgang ueberschritten? Braucht einen GPS-Fix aus dieser Session und die (GPS-)Uhrzeit.
+bool sunriseReached() {
+  if (!night.hasFix || millis() - sessionStartMillis < SESSION_MIN_SUNRISE) return false;
+  DateTime now = rtc.now(); int dayMin = now.hour() * 60 + now.minute();
+  if (now.day() != sunriseDay) { sunriseDay = now.day(); sunriseMin = sunriseMinutesUTC(now.year(), now.month(), now.day(), night.lat, night.lon); }
+  bool crossed = sunriseMin >= 0 && lastDayMin >= 0 && lastDayMin <= dayMin && lastDayMin < sunriseMin && dayMin >= sunriseMin;
+  lastDayMin = dayMin;
+  return crossed;
+}
+
+// --- GPX/KML EXPORT ---
+// Liest die Session-CSV zeilenweise (fester Puffer, konstanter Speicher) und streamt den Track
+// per Chunked Transfer. Die Spalten werden ueber die Kopfzeile gefunden, nicht ueber Positionen.
+enum { COL_DATE, COL_TIME, COL_TEMP, COL_HUM, COL_PRES, COL_WIND, COL_LAT, COL_LON, COL_N };
+const char* const LOG_COLS[COL_N] = { "Date", "Time", "Temp", "Hum", "Pres", "WindAvg", "Lat", "Lon" };
+struct LogRow { int d, mo, y, h, mi, s; float temp, hum, pres, wind; double lat, lon; };
+
+struct LogReader {
+  static const size_t LINE = 256;   // Zeilenpuffer am Ende des ioPool-Blocks, davor der Lesepuffer
+  File f; IoBuf* io = nullptr; char* line = nullptr; size_t len = 0, pos = 0; int col[COL_N];
+  ~LogReader() { close(); }
+  bool open(const String &name) {
+    len = pos = 0;
+    if (!io && !(io = ioPool.alloc())) return false;
+    line = (char*)io->b + sizeof(io->b) - LINE;
+    f = SD.open(name, FILE_READ); if (!f) return false;
+    for (int i = 0; i < COL_N; i++) col[i] = -1;
+    if (!readLine()) return false;
+    char* tok = strtok(line, ",\r"); int idx = 0;
+    while (tok) { for (int i = 0; i < COL_N; i++) if (!strcmp(tok, LOG_COLS[i])) col[i] = idx; tok = strtok(nullptr, ",\r"); idx++; }
+    return col[COL_DATE] >= 0 && col[COL_TIME] >= 0 && col[COL_LAT] >= 0 && col[COL_LON] >= 0;
+  }
+  bool readLine() {
+    size_t n = 0;
+    while (true) {
+      if (pos >= len) { len = f.read(io->b, sizeof(io->b) - LINE); pos = 0; if (len == 0) { line[n] = 0; return n > 0; } }
+      char c = io->b[pos++];
+      if (c == '\n') { line[n] = 0; return true; }
+      if (n < LINE - 1) line[n++] = c;
+    }
+  }
+  // Naechste Zeile mit gueltiger Position (0/0 = kein Fix beim Loggen)
+  bool next(LogRow &r) {
+    while (readLine()) {
+      const char* field[16]; int nf = 0; char* p = line; field[nf++] = p;
+      while (*p && nf < 16) { if (*p == ',') { *p = 0; field[nf++] = p + 1; } p++; }
+      bool ok = true; for (int i = 0; i < COL_N; i++) if (col[i] >= nf) ok = false;
+      if (!ok) continue;
+      auto num = [&](int c) { return col[c] >= 0 ? atof(field[col[c]]) : NAN; };
+      if (sscanf(field[col[COL_DATE]], "%d.%d.%d", &r.d, &r.mo, &r.y) != 3 || sscanf(field[col[COL_TIME]], "%d:%d:%d", &r.h, &r.mi, &r.s) != 3) continue;
+      r.temp = num(COL_TEMP); r.hum = num(COL_HUM); r.pres = num(COL_PRES); r.wind = num(COL_WIND); r.lat = num(COL_LAT); r.lon = num(COL_LON);
+      if (r.lat == 0.0 && r.lon == 0.0) continue;
+      return true;
+    }
+    return false;
+  }
+  // Zweiter Durchlauf in derselben Datei (Puffer bleibt geliehen), Kopfzeile ueberspringen
+  bool rewind() { len = pos = 0; return io && f.seek(0) && readLine(); }
+  void close() { f.close(); if (io) ioPool.release(io); io = nullptr; }
+};
+
+struct ChunkOut {
+  IoLease io; size_t len = 0;
+  ChunkOut() : io(ioPool) {}
+  void add(const char* fmt, ...) {
+    char tmp[320]; va_list ap; va_start(ap, fmt); int n = vsnprintf(tmp, sizeof(tmp), fmt, ap); va_end(ap);
+    if (n <= 0) return;
+    if ((size_t)n >= sizeof(tmp)) n = sizeof(tmp) - 1;
+    if (len + n > sizeof(io->b)) flush();
+    memcpy(io->b + len, tmp, n); len += n;
+  }
+  void flush() { if (len) server.sendContent((const char*)io->b, len); len = 0; }
+  void end() { flush(); server.sendContent(""); }
+};
+
+bool validLogName(const String &n) { return n.startsWith("/") && n.endsWith(".csv") && n.indexOf("..") < 0 && n.indexOf('/', 1) < 0; }
+
+void handleExport(bool kml) {
+  String name = server.hasArg("file") ? server.arg("file") : logFileName;
+  if (!sdCardOK || !validLogName(name)) { server.send(404, "text/plain", "NO LOG FILE"); return; }
+  LogReader rd;   // Lese- und Zeilenpuffer im geliehenen ioPool-Block, nicht auf dem Stack
+  ChunkOut out;
+  if (!out.io) { server.send(503, "text/plain", "BUSY"); return; }
+  if (!rd.open(name)) { rd.close(); server.send(404, "text/plain", "LOG NOT READABLE"); return; }
+  String base = name.substring(1, name.length() - 4);
+  server.sendHeader("Content-Disposition", "attachment; filename=\"" + base + (kml ? ".kml\"" : ".gpx\""));
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, kml ? "application/vnd.google-earth.kml+xml" : "application/gpx+xml", "");
+  LogRow r;
+  if (kml) {
+    out.add("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<kml xmlns=\"http://www.opengis.net/kml/2.2\"><Document><name>NEXUS %s</name>\n", base.c_str());
+    out.add("<Style id=\"trk\"><LineStyle><color>ff00ffff</color><width>3</width></LineStyle></Style>\n");
+    out.add("<Placemark><name>Track</name><styleUrl>#trk</styleUrl><LineString><tessellate>1</tessellate><coordinates>\n");
+    while (rd.next(r)) out.add("%.6f,%.6f,0\n", r.lon, r.lat);
+    out.add("</coordinates></LineString></Placemark>\n<Folder><name>Messpunkte</name>\n");
+    if (!rd.rewind()) { server.client().stop(); return; }   // zweiter Durchlauf fuer die Punkte; sonst abbrechen statt leer liefern
+    while (rd.next(r)) {
+      out.add("<Placemark><TimeStamp><when>%04d-%02d-%02dT%02d:%02d:%02dZ</when></TimeStamp>", r.y, r.mo, r.d, r.h, r.mi, r.s);
+      out.add("<description>T %.2f C | H %.1f %% | P %.1f hPa | Wind %.2f m/s</description><Point><coordinates>%.6f,%.6f,0</coordinates></Point></Placemark>\n", r.temp, r.hum, r.pres, r.wind, r.lon, r.lat);
+    }
+    out.add("</Folder></Document></kml>\n");
+  } else {
+    out.add("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<gpx version=\"1.1\" creator=\"NEXUS\" xmlns=\"http://www.topografix.com/GPX/1/1\" ");
+    out.add("xmlns:gpxtpx=\"http://www.garmin.com/xmlschemas/TrackPointExtension/v1\" xmlns:nexus=\"https://github.com/scanjack/NEXUS_DIY_Sensorik\">\n");
+    // Standort der Station = erster gueltiger Fix der Session
+    if (rd.next(r)) out.add("<wpt lat=\"%.6f\" lon=\"%.6f\"><time>%04d-%02d-%02dT%02d:%02d:%02dZ</time><name>NEXUS %s</name></wpt>\n", r.lat, r.lon, r.y, r.mo, r.d, r.h, r.mi, r.s, base.c_str());
+    if (!rd.rewind()) { server.client().stop(); return; }
+    out.add("<trk><name>NEXUS %s</name><trkseg>\n", base.c_str());
+    while (rd.next(r)) {
+      out.add("<trkpt lat=\"%.6f\" lon=\"%.6f\"><time>%04d-%02d-%02dT%02d:%02d:%02dZ</time>", r.lat, r.lon, r.y, r.mo, r.d, r.h, r.mi, r.s);
+      out.add("<extensions><gpxtpx:TrackPointExtension><gpxtpx:atemp>%.2f</gpxtpx:atemp></gpxtpx:TrackPointExtension>", r.temp);
+      out.add("<nexus:hum>%.1f</nexus:hum><nexus:pres>%.1f</nexus:pres><nexus:wind>%.2f</nexus:wind></extensions></trkpt>\n", r.hum, r.pres, r.wind);
+    }
+    out.add("</trkseg></trk></gpx>\n");
+  }
+  rd.close();
+  out.end();
+}
 
 // --- WEB INTERFACE ---
 String getHTML() {
@@ -132,16 +1570,28 @@ String getHTML() {
   ptr += "document.getElementById('w_dir').innerText=d.w_dir;document.getElementById('rain').innerText=d.rain.toFixed(1);";
   
   // --- HIER WURDE NACHGEBESSERT (JavaScript Mapper) ---
-  ptr += "document.getElementById('a20').innerText=d.a20.toFixed(2);";
-  ptr += "document.getElementById('a40').innerText=d.a40.toFixed(2);";
-  ptr += "document.getElementById('a55').innerText=d.a55.toFixed(2);";
-  ptr += "document.getElementById('a80').innerText=d.a80.toFixed(2);";
-  ptr += "document.getElementById('a110').innerText=d.a110.toFixed(2);";
+  ptr += "document.getElementById('a20').innerText=d.a20.toFixed(2)+' \u00b1'+d.u20.toFixed(2);";
+  ptr += "document.getElementById('a40').innerText=d.a40.toFixed(2)+' \u00b1'+d.u40.toFixed(2);";
+  ptr += "document.getElementById('a55').innerText=d.a55.toFixed(2)+' \u00b1'+d.u55.toFixed(2);";
+  ptr += "document.getElementById('a80').innerText=d.a80.toFixed(2)+' \u00b1'+d.u80.toFixed(2);";
+  ptr += "document.getElementById('a110').innerText=d.a110.toFixed(2)+' \u00b1'+d.u110.toFixed(2);";
   
   ptr += "if(d.gps_v){document.getElementById('gps_raw').innerText=d.lat.toFixed(6)+', '+d.lon.toFixed(6); document.getElementById('gps_alt').innerText='Alt: '+d.alt+'m | Sats: '+d.sats;";
   ptr += "}else{document.getElementById('gps_raw').innerText='WAITING FOR FIX...';}";
-  ptr += "document.getElementById('stat').innerText=d.mode + (d.synced ? ' (GPS-TIME)' : ' (RTC-MODE)');";
-  ptr += "});}setInterval(u,2000);window.onload=u;</script></head><body>";
+  ptr += "document.getElementById('stat').innerText=d.mode + (d.synced ? ' (GPS-TIME)' : ' (RTC-MODE)') + ' #' + d.chain;";
+  ptr += "});}";
+  // Raster-Overlay: Zellmittelwerte als Farbkacheln (blau = kalt, rot = warm)
+  ptr += "function g(){fetch('/grid').then(r=>r.json()).then(d=>{let c=document.getElementById('grid'),x=c.getContext('2d');x.fillStyle='#000060';x.fillRect(0,0,c.width,c.height);";
+  ptr += "if(!d.cells.length)return;let la=d.cells.map(e=>e[0]),lo=d.cells.map(e=>e[1]),t=d.cells.map(e=>e[3]);";
+  ptr += "let a0=Math.min(...la),a1=Math.max(...la),o0=Math.min(...lo),o1=Math.max(...lo),t0=Math.min(...t),t1=Math.max(...t),s=Math.max(a1-a0,o1-o0,1e-3);";
+  ptr += "d.cells.forEach(e=>{let k=(e[3]-t0)/((t1-t0)||1);x.fillStyle='hsl('+(240-240*k)+',100%,50%)';x.fillRect(10+(e[1]-o0)/s*(c.width-30),c.height-20-(e[0]-a0)/s*(c.height-30),8,8);});";
+  ptr += "document.getElementById('grid_i').innerText=d.cells.length+' Zellen | '+t0.toFixed(1)+'..'+t1.toFixed(1)+' C';});}";
+  // Windrose: gestapelte Sektorbalken je Geschwindigkeitsklasse, Flaute als Text
+  ptr += "function w(){fetch('/windrose').then(r=>r.json()).then(d=>{let c=document.getElementById('rose'),x=c.getContext('2d'),m=c.width/2,mx=1;x.fillStyle='#000060';x.fillRect(0,0,c.width,c.height);";
+  ptr += "d.hist.forEach(h=>{mx=Math.max(mx,h.reduce((a,b)=>a+b,0));});let col=['#80f','#08f','#0f8','#ff0','#f80','#f00'];";
+  ptr += "d.hist.forEach((h,i)=>{let r0=0,a=(i*22.5-90-9)*Math.PI/180,b=(i*22.5-90+9)*Math.PI/180;h.forEach((v,k)=>{let r1=r0+v/mx*(m-10);x.fillStyle=col[k];x.beginPath();x.arc(m,m,r1,a,b);x.arc(m,m,r0,b,a,true);x.fill();r0=r1;});});";
+  ptr += "document.getElementById('rose_i').innerText='Flaute '+(100*d.calm_s/Math.max(d.total_s,1)).toFixed(0)+'% | Phasen '+d.calm_spells+' | max '+(d.longest_calm_s/60).toFixed(0)+' min';});}";
+  ptr += "setInterval(u,2000);setInterval(g,30000);setInterval(w,30000);window.onload=()=>{u();g();w();};</script></head><body>";
   ptr += "<h1>> NEXUS SCIENTIFIC</h1><div class='status-box'>● SYSTEM: <span id='stat'>LOADING...</span></div>";
   ptr += "<div class='card'><h2>[ ATMOSPHÄRE ]</h2><table><tr><td>Temp</td><td class='val'><span id='temp'>--</span> C</td></tr><tr><td>Hum</td><td class='val'><span id='hum'>--</span> %</td></tr><tr><td>Dew</td><td class='val'><span id='dew'>--</span> C</td></tr><tr><td>Pres</td><td class='val'><span id='pres'>--</span> hPa</td></tr></table></div>";
   ptr += "<div class='card'><h2>[ WETTER ]</h2><table><tr><td>Wind Avg</td><td class='val'><span id='w_avg'>--</span> m/s</td></tr><tr><td>Wind Böe</td><td class='val'><span id='w_gst'>--</span> m/s</td></tr><tr><td>Regen</td><td class='val'><span id='rain'>--</span> mm</td></tr><tr><td>Dir</td><td class='val'><span id='w_dir'>--</span></td></tr></table></div>";
@@ -155,39 +1605,898 @@ String getHTML() {
   ptr += "<tr><td>110 kHz</td><td class='val'><span id='a110'>--</span></td></tr>";
   ptr += "</table></div>";
 
-  ptr += "<div class='card'><h2>[ POSITION ]</h2><div id='gps-box'><span id='gps_raw'>--</span><br><span id='gps_alt'>--</span></div></div>";
+  ptr += "<div class='card'><h2>[ POSITION ]</h2><div id='gps-box'><span id='gps_raw'>--</span><br><span id='gps_alt'>--</span><br><a href='/export/gpx' style='color:#FFFF00'>GPX</a> | <a href='/export/kml' style='color:#FFFF00'>KML</a></div></div>";
+  ptr += "<div class='card'><h2>[ WINDROSE ]</h2><canvas id='rose' width='200' height='200' style='display:block;margin:auto'></canvas><div id='gps-box'><span id='rose_i'>--</span></div></div>";
+  ptr += "<div class='card'><h2>[ RASTER ]</h2><canvas id='grid' width='300' height='200' style='width:100%'></canvas><div id='gps-box'><span id='grid_i'>--</span> <a href='/grid.csv' style='color:#FFFF00'>CSV</a></div></div>";
   ptr += "<p style='text-align:center;'>READY._</p></body></html>";
   return ptr;
 }
 
+// --- USB-LINK ---
+// Dieselben Endpunkte ueber das USB-Kabel (natives USB des S3, TinyUSB-CDC) statt ueber den geteilten AP.
+// Der Laptop schickt eine HTTP/1.0-Anfrage als Rahmen ("NXU1", u32 Laenge, Anfrage); ein eigener Task
+// reicht sie ueber die Loopback-Schnittstelle (127.0.0.1:80) an den WebServer weiter und die Antwort in
+// Rahmen zurueck ("NXUD", u16 Laenge, Daten ... "NXUE", 2, Status 0 = ok). Eigener Task auf Kern 0, weil
+// server.handleClient() in loop() bei grossen Antworten erst weiterkommt, wenn jemand mitliest.
+// Ueber USB laesst sich der AP abschalten (/link?ap=0); ohne USB-Verkehr geht er nach 10 min wieder an.
+#define USB_REQ_MAX       1024
+#define USB_CHUNK         2048
+#define USB_TIMEOUT_MS    15000
+#define USB_AP_RESTORE_MS 600000UL
+struct UsbLinkStats { uint32_t requests, errors, bytesIn, bytesOut; unsigned long lastMs; };
+UsbLinkStats usbStats = {};
+bool apOn = false, apOffByUsb = false; unsigned long apSince = 0, apOnMs = 0;   // AP-Laufzeit fuer den Stromvergleich
+void apSet(bool on) {
+  if (on == apOn) return;
+  if (on) WiFi.softAP(ssid, password); else WiFi.softAPdisconnect(true);
+  if (on) apSince = millis(); else apOnMs += millis() - apSince;
+  apOn = on;
+}
+unsigned long apOnSeconds() { return (apOnMs + (apOn ? millis() - apSince : 0)) / 1000; }
+#if USB_LINK
+USBCDC usbLink;
+bool usbRead(uint8_t* d, size_t n, unsigned long timeoutMs) {
+  unsigned long t0 = millis();
+  while (n) {
+    size_t r = usbLink.read(d, n); d += r; n -= r;
+    if (!r) { if (millis() - t0 > timeoutMs) return false; vTaskDelay(1); }
+  }
+  return true;
+}
+bool usbWrite(const void* d, size_t n) {
+  const uint8_t* p = (const uint8_t*)d; unsigned long t0 = millis();
+  while (n) {
+    size_t w = usbLink.write(p, n); p += w; n -= w;
+    if (!w) { if (!usbLink || millis() - t0 > USB_TIMEOUT_MS) return false; vTaskDelay(1); }
+  }
+  return true;
+}
+bool usbFrame(const char* tag, const void* d, uint16_t n) { return usbWrite(tag, 4) && usbWrite(&n, 2) && usbWrite(d, n); }
+void usbLinkTask(void*) {
+  static uint8_t buf[USB_CHUNK];
+  uint32_t sync = 0; uint8_t c;
+  for (;;) {
+    if (usbLink.read(&c, 1) != 1) { vTaskDelay(2); continue; }
+    sync = sync << 8 | c;
+    if (sync != 0x4E585531) continue;   // "NXU1", alles andere wird verworfen
+    sync = 0; uint32_t len = 0;
+    if (!usbRead((uint8_t*)&len, 4, 1000) || !len || len > USB_REQ_MAX || !usbRead(buf, len, 1000)) { usbStats.errors++; continue; }
+    usbStats.requests++; usbStats.bytesIn += len; usbStats.lastMs = millis();
+    uint16_t status = 1; WiFiClient cl;   // 1 = Webserver nicht erreichbar, 2 = Zeitueberschreitung, 3 = USB
+    if (cl.connect(IPAddress(127, 0, 0, 1), 80)) {
+      cl.write(buf, len); status = 2;
+      for (unsigned long t0 = millis(); millis() - t0 < USB_TIMEOUT_MS; ) {
+        int n = cl.read(buf, sizeof(buf));
+        if (n > 0) { if (!usbFrame("NXUD", buf, n)) { status = 3; break; } usbStats.bytesOut += n; t0 = millis(); }
+        else if (!cl.connected()) { status = 0; break; }
+        else vTaskDelay(1);
+      }
+      cl.stop();
+    }
+    if (status) usbStats.errors++;
+    usbFrame("NXUE", &status, 2);
+    usbStats.lastMs = millis();
+  }
+}
+void usbLinkBegin() {
+  usbLink.begin(); USB.begin();
+  xTaskCreatePinnedToCore(usbLinkTask, "usblink", 4096, nullptr, 1, nullptr, 0);
+}
+#endif
+
+// --- BLE-STATUS ---
+// "Loggt sie noch, wie steht der Wind?" braucht keinen AP, der die ganze Nacht laeuft: ein GATT-Dienst mit
+// 20 Byte Status (passt ohne MTU-Aushandlung in eine Notification), verschickt nur bei Aenderung, und ein
+// Steuerkanal, der den AP bei Bedarf startet. Ist der AP sonst aus (WIFI_AP_AT_BOOT 0), geht er wieder aus,
+// wenn AP_DEMAND_IDLE_MS lang kein Client verbunden war. Dekodierung: nexus_ble_status.py.
+// Der Status ist offen lesbar, schreiben duerfen nur gekoppelte Geraete: Koppeln per Passkey (SECRET_BLE_PIN,
+// LE Secure Connections mit MITM-Schutz und Bonding), der Steuerkanal verlangt eine so verschluesselte Verbindung.
+#define BLE_SERVICE_UUID   "6e580001-7c2a-4b5e-9d1f-4e4558555301"
+#define BLE_STATUS_UUID    "6e580002-7c2a-4b5e-9d1f-4e4558555301"
+#define BLE_CONTROL_UUID   "6e580003-7c2a-4b5e-9d1f-4e4558555301"
+#define BLE_STATUS_VERSION 1
+#define BLE_ADV_INTERVAL   1600          // 0,625-ms-Einheiten = 1 s
+#define AP_DEMAND_IDLE_MS  600000UL
+enum BleCommand : uint8_t { BLE_CMD_AP_OFF = 0, BLE_CMD_AP_ON = 1, BLE_CMD_REFRESH = 2 };
+enum BleFlag : uint8_t { BLE_F_LOGGING = 1, BLE_F_SD = 2, BLE_F_FIX = 4, BLE_F_SYNCED = 8, BLE_F_AP = 16, BLE_F_STATIONARY = 32, BLE_F_BME_STALE = 64, BLE_F_AP_DEMAND = 128 };
+struct __attribute__((packed)) BleStatus {
+  uint8_t verSats;       // Version (3 Bit) | Satelliten (5 Bit, max. 31)
+  uint8_t flags;         // BLE_F_*
+  uint8_t records[3];    // Datensaetze der laufenden Session (24 Bit)
+  uint16_t ringPending;  // Datensaetze im Flash-Ring, noch nicht auf SD
+  uint8_t sdFailures;    // gesaettigt
+  uint16_t vbatMv;       // 0 = nicht gemessen
+  int16_t temp;          // 0,01 C
+  uint8_t hum;           // 0,5 %
+  uint16_t pres;         // 0,1 hPa
+  uint8_t wind, gust;    // 0,1 m/s, gesaettigt
+  uint8_t dir;           // 2 Grad, 255 = Flaute/unbekannt
+  uint16_t rain;         // 0,01 mm seit Sessionbeginn
+};
+static_assert(sizeof(BleStatus) == 20, "BLE-Status muss in eine Notification mit Standard-MTU passen");
+bool apOnDemand = false; unsigned long apIdleSince = 0;
+void bleEncode(BleStatus &s) {
+  s.verSats = BLE_STATUS_VERSION << 5 | min(gps.satellites.value(), (uint32_t)31);
+  s.flags = (appState == 2 ? BLE_F_LOGGING : 0) | (sdCardOK ? BLE_F_SD : 0) | (gps.location.isValid() ? BLE_F_FIX : 0) | (timeSynced ? BLE_F_SYNCED : 0)
+    | (apOn ? BLE_F_AP : 0) | (isStationary ? BLE_F_STATIONARY : 0) | (measureTask.bmeOk ? 0 : BLE_F_BME_STALE) | (apOnDemand ? BLE_F_AP_DEMAND : 0);
+  uint32_t n = appState == 2 ? min(recordSeq, (uint32_t)0xFFFFFF) : 0; memcpy(s.records, &n, 3);
+  s.ringPending = min(ringPending, (uint32_t)65535); s.sdFailures = min(sdFailures, (uint32_t)255);
+  s.vbatMv = PIN_VBAT < 0 ? 0 : analogReadMilliVolts(PIN_VBAT) * VBAT_DIVIDER;
+  s.temp = (int16_t)lroundf(bme.temperature * 100); s.hum = (uint8_t)lroundf(constrain(bme.humidity, 0.0f, 100.0f) * 2); s.pres = (uint16_t)lroundf(bme.pressure / 10.0f);
+  s.wind = (uint8_t)min(lroundf(currentWindSpeedAverage * 10), 255L); s.gust = (uint8_t)min(lroundf(displayWindGust * 10), 255L);
+  s.dir = currentWindDirDeg < 0 ? 255 : currentWindDirDeg / 2;
+  s.rain = (uint16_t)min(lroundf(night.rainMM * 100), 65535L);
+}
+#if BLE_STATUS
+BLECharacteristic* bleStatusChr = nullptr; BleStatus bleLast = {};
+volatile int8_t bleApRequest = -1; volatile bool bleRefresh = false;
+volatile uint8_t bleClients = 0; uint32_t bleNotifies = 0;
+struct BleServerCb : BLEServerCallbacks {
+  void onConnect(BLEServer*) override { bleClients++; bleRefresh = true; }
+  void onDisconnect(BLEServer*) override { if (bleClients) bleClients--; BLEDevice::startAdvertising(); }
+};
+struct BleControlCb : BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic* c) override {   // BT-Task: nur vormerken, geschaltet wird in loop()
+    std::string v = c->getValue();
+    if (v.size() != 1) return;
+    if (v[0] == BLE_CMD_AP_OFF || v[0] == BLE_CMD_AP_ON) bleApRequest = v[0]; else if (v[0] == BLE_CMD_REFRESH) bleRefresh = true;
+  }
+};
+void bleBegin() {
+  char name[16]; snprintf(name, sizeof(name), "NEXUS-%04X", (unsigned)(stationId & 0xFFFF));
+  BLEDevice::init(name);
+  BLEServer* srv = BLEDevice::createServer(); srv->setCallbacks(new BleServerCb());
+  BLEService* svc = srv->createService(BLE_SERVICE_UUID);
+  bleStatusChr = svc->createCharacteristic(BLE_STATUS_UUID, BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY);
+  bleStatusChr->addDescriptor(new BLE2902());
+  BLESecurity* sec = new BLESecurity(); sec->setStaticPIN(SECRET_BLE_PIN); sec->setAuthenticationMode(ESP_LE_AUTH_REQ_SC_MITM_BOND);
+  BLECharacteristic* ctl = svc->createCharacteristic(BLE_CONTROL_UUID, BLECharacteristic::PROPERTY_WRITE);
+  ctl->setAccessPermissions(ESP_GATT_PERM_WRITE_ENC_MITM); ctl->setCallbacks(new BleControlCb());
+  svc->start();
+  BLEAdvertising* adv = BLEDevice::getAdvertising();
+  adv->addServiceUUID(BLE_SERVICE_UUID); adv->setMinInterval(BLE_ADV_INTERVAL); adv->setMaxInterval(BLE_ADV_INTERVAL);
+  BLEDevice::startAdvertising();
+}
+// Je neuer Veroeffentlichung (pubVersion) einmal kodieren; Notification nur, wenn sich ein Byte geaendert hat
+void bleLoop() {
+  if (bleApRequest >= 0) {
+    bool on = bleApRequest == BLE_CMD_AP_ON; bleApRequest = -1;
+    apSet(on); apOnDemand = on && !WIFI_AP_AT_BOOT; apOffByUsb = false; apIdleSince = millis(); bleRefresh = true;
+  }
+  static uint32_t seen = 0;
+  if (!bleClients || (seen == pubVersion && !bleRefresh)) return;
+  seen = pubVersion;
+  BleStatus s; bleEncode(s);
+  if (!bleRefresh && !memcmp(&s, &bleLast, sizeof(s))) return;
+  bleRefresh = false; bleLast = s;
+  bleStatusChr->setValue((uint8_t*)&s, sizeof(s)); bleStatusChr->notify(); bleNotifies++;
+}
+#endif
+void linkLoop() {
+  if (apOffByUsb && millis() - usbStats.lastMs > USB_AP_RESTORE_MS) { apOffByUsb = false; apSet(true); }
+  if (apOnDemand) {
+    if (WiFi.softAPgetStationNum()) apIdleSince = millis();
+    else if (millis() - apIdleSince > AP_DEMAND_IDLE_MS) { apSet(false); apOnDemand = false; }
+  }
+#if BLE_STATUS
+  bleLoop();
+#endif
+}
+// Abschalten nur ueber USB (Loopback), sonst saegt sich ein WLAN-Client den eigenen Ast ab
+void handleLink() {
+  bool viaUsb = server.client().remoteIP() == IPAddress(127, 0, 0, 1);
+  if (server.hasArg("ap")) {
+    bool on = server.arg("ap") == "1";
+    if (!on && !viaUsb) { server.send(403, "text/plain", "AP OFF ONLY VIA USB"); return; }
+    apSet(on); apOffByUsb = !on && WIFI_AP_AT_BOOT; apOnDemand = false;
+  }
+  String j = "{\"usb\":" + String(USB_LINK ? "true" : "false") + ",\"via_usb\":" + String(viaUsb ? "true" : "false") + ",\"ap\":" + String(apOn ? "true" : "false")
+    + ",\"ap_restore_s\":" + String(apOffByUsb ? (long)(USB_AP_RESTORE_MS - (millis() - usbStats.lastMs)) / 1000 : -1)
+    + ",\"requests\":" + String(usbStats.requests) + ",\"errors\":" + String(usbStats.errors)
+    + ",\"bytes_in\":" + String(usbStats.bytesIn) + ",\"bytes_out\":" + String(usbStats.bytesOut)
+    + ",\"ap_on_s\":" + String(apOnSeconds()) + ",\"uptime_s\":" + String(millis() / 1000) + ",\"ble\":" + String(BLE_STATUS ? "true" : "false");
+#if BLE_STATUS
+  j += ",\"ble_clients\":" + String(bleClients) + ",\"ble_notifies\":" + String(bleNotifies);
+#endif
+  BleStatus st; bleEncode(st);
+  char hex[2 * sizeof(st) + 1]; for (size_t i = 0; i < sizeof(st); i++) snprintf(hex + 2 * i, 3, "%02x", ((uint8_t*)&st)[i]);
+  j += ",\"ble_status\":\"" + String(hex) + "\"}";
+  server.send(200, "application/json", j);
+}
+
+// --- MQTT (STA+AP) ---
+// Gibt es am Standort ein Netz mit Broker, meldet sich die Station dort zusaetzlich zum AP als Client an und
+// liefert selbst, statt dass Handys /data abfragen. Minimaler MQTT-3.1.1-Client: /data-Schnappschuss mit
+// QoS 0 (retained) je Messung, Datensaetze gebuendelt im /sync-Format ("NXSB") mit QoS 1, immer nur ein
+// Paket unterwegs. Die Warteschlange ist das Binaer-Log selbst: der Cursor (Session, Seq) in MQTT_CURSOR_FILE
+// rueckt erst mit dem PUBACK vor, nach einer Funk- oder Broker-Luecke wird ab dort nachgeschickt.
+// Ohne Cursor-Datei beginnt die Station mit der naechsten Session. Der AP folgt dem Kanal des Routers.
+#define MQTT_ENABLED        (sizeof(SECRET_STA_SSID) > 1 && sizeof(MQTT_HOST) > 1)
+#define MQTT_KEEPALIVE_S    60
+#define MQTT_CONNECT_MS     1000         // blockiert loop() hoechstens so lange (Broker-Host nicht erreichbar)
+#define MQTT_BATCH          8            // live: ein Paket je 8 Datensaetze (ca. 1 min)
+#define MQTT_BATCH_DRAIN    64           // Rueckstand: bis 64 Datensaetze (ca. 2,7 KB) je Paket
+#define MQTT_ACK_TIMEOUT_MS 10000
+#define MQTT_MAX_RETRIES    3
+#define MQTT_RETRY_MIN_MS   5000
+#define MQTT_RETRY_MAX_MS   120000UL
+#define MQTT_POLL_MS        5000         // ohne neuen Datensatz: so selten ins Log schauen (Session-Wechsel, SD wieder da)
+#define MQTT_CURSOR_FILE    "/mqtt.cur"
+enum MqttState { MQTT_DOWN, MQTT_WAIT_CONNACK, MQTT_UP };
+struct MqttStats { uint32_t connects, drops, msgs, records, bytes, retries, ackMsSum, ackMsMax, snapshots; unsigned long staMs, ioUs; };
+MqttStats mqttStats = {};
+WiFiClient mqttNet;
+MqttState mqttState = MQTT_DOWN;
+uint32_t mqttCurSession = 0, mqttCurSeq = 0, mqttSnapVer = 0;
+uint16_t mqttPid = 0, mqttInflightN = 0; uint8_t mqttTries = 0;
+unsigned long mqttSentAt = 0, mqttLastTx = 0, mqttRetryAt = 0, mqttRetryMs = MQTT_RETRY_MIN_MS, mqttStaLast = 0, mqttPollAt = 0;
+uint32_t mqttSeenAppends = 0;
+String mqttTopic(const char* leaf) { char b[40]; snprintf(b, sizeof(b), "nexus/%08lx/%s", (unsigned long)stationId, leaf); return b; }
+bool mqttWrite(const void* d, size_t n) { mqttLastTx = millis(); return mqttNet.write((const uint8_t*)d, n) == n; }
+bool mqttStr(const char* str, size_t n) { uint8_t l[2] = { (uint8_t)(n >> 8), (uint8_t)n }; return mqttWrite(l, 2) && mqttWrite(str, n); }
+bool mqttFixed(uint8_t type, uint32_t len) {   // Typ + Restlaenge als varint
+  uint8_t h[5]; size_t n = 0; h[n++] = type;
+  do { uint8_t b = len & 127; len >>= 7; h[n++] = b | (len ? 128 : 0); } while (len);
+  return mqttWrite(h, n);
+}
+bool mqttPubHead(uint8_t flags, const String &topic, uint16_t pid, size_t payload) {
+  uint8_t p[2] = { (uint8_t)(pid >> 8), (uint8_t)pid };
+  return mqttFixed(0x30 | flags, 2 + topic.length() + (pid ? 2 : 0) + payload) && mqttStr(topic.c_str(), topic.length()) && (!pid || mqttWrite(p, 2));
+}
+void mqttDrop() {
+  if (mqttState != MQTT_DOWN) mqttStats.drops++;
+  mqttNet.stop(); mqttState = MQTT_DOWN; mqttInflightN = 0;   // unbestaetigtes Paket geht nach dem Neuaufbau nochmal raus
+  mqttRetryAt = millis() + mqttRetryMs; mqttRetryMs = min(mqttRetryMs * 2, MQTT_RETRY_MAX_MS);
+}
+void mqttConnect() {
+  unsigned long t0 = micros();
+  mqttStats.connects++;
+  if (!mqttNet.connect(MQTT_HOST, MQTT_PORT, MQTT_CONNECT_MS)) { mqttStats.ioUs += micros() - t0; mqttDrop(); return; }
+  mqttNet.setNoDelay(true);
+  String id = "nexus-" + String(stationId, HEX), will = mqttTopic("online");
+  uint8_t vh[10] = { 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02 | 0x04 | 0x20, 0, MQTT_KEEPALIVE_S };   // clean session, Will retained "0"
+  bool ok = mqttFixed(0x10, sizeof(vh) + 2 + id.length() + 2 + will.length() + 2 + 1) && mqttWrite(vh, sizeof(vh))
+    && mqttStr(id.c_str(), id.length()) && mqttStr(will.c_str(), will.length()) && mqttStr("0", 1);
+  mqttStats.ioUs += micros() - t0;
+  if (!ok) { mqttDrop(); return; }
+  mqttState = MQTT_WAIT_CONNACK; mqttSentAt = millis();
+}
+void mqttSaveCursor() {
+  File f = SD.open(MQTT_CURSOR_FILE, FILE_WRITE);
+  if (f) { f.write((const uint8_t*)&mqttCurSession, 4); f.write((const uint8_t*)&mqttCurSeq, 4); f.close(); }
+}
+void mqttLoadCursor() {
+  File f = SD.open(MQTT_CURSOR_FILE, FILE_READ);
+  if (f && (f.read((uint8_t*)&mqttCurSession, 4) != 4 || f.read((uint8_t*)&mqttCurSeq, 4) != 4)) mqttCurSession = mqttCurSeq = 0;
+  if (f) f.close();
+}
+uint32_t mqttNextSession(uint32_t after) {   // kleinste Session-ID > after aus dem Session-Index
+  File idx = SD.open(SESSION_INDEX, FILE_READ); uint32_t best = 0;
+  while (idx && idx.available()) { uint32_t id = strtoul(idx.readStringUntil('\n').c_str(), nullptr, 10); if (id > after && (!best || id < best)) best = id; }
+  if (idx) idx.close();
+  return best;
+}
+// Ein Paket ab dem Cursor: live erst ab MQTT_BATCH neuen Datensaetzen, Rueckstand in groesseren Paketen.
+// Abgeschlossene Sessions werden uebersprungen, sobald sie vollstaendig bestaetigt sind.
+void mqttSendBatch(bool resend) {
+  IoLease io(ioPool);
+  if (!io) return;
+  if (!mqttCurSession) { if (appState != 2 || !sessionId) return; mqttCurSession = sessionId; mqttCurSeq = 0; mqttSaveCursor(); }
+  File f = SD.open(sessionBase(mqttCurSession) + ".bin", FILE_READ); uint8_t fh[6] = { 0 };
+  bool live = mqttCurSession == sessionId && appState == 2;
+  if (!f || f.read(fh, 6) != 6 || fh[5] != sizeof(LogRecord)) {   // fehlt oder altes Format: weiter zur naechsten Session
+    if (f) f.close();
+    uint32_t next = live ? 0 : mqttNextSession(mqttCurSession);
+    if (next) { mqttCurSession = next; mqttCurSeq = 0; mqttSaveCursor(); mqttPollAt = millis(); }
+    return;
+  }
+  uint32_t total = (f.size() - LOGBIN_HEADER) / sizeof(LogRecord), avail = total > mqttCurSeq ? total - mqttCurSeq : 0;
+  if (!resend) {
+    if (!avail || (live && avail < MQTT_BATCH)) {
+      f.close();
+      uint32_t next = !avail && !live ? mqttNextSession(mqttCurSession) : 0;
+      if (next) { mqttCurSession = next; mqttCurSeq = 0; mqttSaveCursor(); mqttPollAt = millis(); }
+      return;
+    }
+    mqttInflightN = min(avail, (uint32_t)MQTT_BATCH_DRAIN); mqttTries = 0;
+    if (++mqttPid == 0) mqttPid = 1;
+  }
+  if (avail < mqttInflightN) { f.close(); mqttInflightN = 0; return; }
+  unsigned long t0 = micros();
+  uint16_t count = mqttInflightN;
+  uint8_t hdr[24] = { 'N', 'X', 'S', 'B', LOGBIN_VERSION, sizeof(LogRecord) };
+  memcpy(hdr + 6, &count, 2); memcpy(hdr + 8, &stationId, 4); memcpy(hdr + 12, &mqttCurSession, 4); memcpy(hdr + 16, &mqttCurSeq, 4); memcpy(hdr + 20, &total, 4);
+  size_t payload = sizeof(hdr) + (size_t)count * sizeof(LogRecord) + 4;
+  bool ok = mqttPubHead(0x02 | (resend ? 0x08 : 0), mqttTopic("records"), mqttPid, payload) && mqttWrite(hdr, sizeof(hdr));
+  uint32_t crc = crc32Update(0, hdr, sizeof(hdr));
+  f.seek(LOGBIN_HEADER + mqttCurSeq * sizeof(LogRecord));
+  for (uint32_t left = (uint32_t)count * sizeof(LogRecord); ok && left > 0; ) {
+    size_t n = f.read(io->b, min((uint32_t)sizeof(io->b), left));
+    ok = n > 0 && mqttWrite(io->b, n); crc = crc32Update(crc, io->b, n); left -= n;
+  }
+  f.close();
+  ok = ok && mqttWrite(&crc, 4);
+  mqttStats.ioUs += micros() - t0;
+  if (!ok) { mqttDrop(); return; }
+  mqttSentAt = millis(); mqttStats.bytes += payload;
+  if (resend) mqttStats.retries++;
+}
+void mqttPuback(uint16_t pid) {
+  if (!mqttInflightN || pid != mqttPid) return;
+  uint32_t ms = millis() - mqttSentAt;
+  mqttStats.msgs++; mqttStats.records += mqttInflightN; mqttStats.ackMsSum += ms; mqttStats.ackMsMax = max(mqttStats.ackMsMax, ms);
+  mqttCurSeq += mqttInflightN; mqttInflightN = 0; mqttSaveCursor();
+  mqttPollAt = millis();   // Rueckstand gleich weiter abbauen
+}
+void mqttRead() {
+  while (mqttNet.available() >= 2) {   // CONNACK, PUBACK, PINGRESP: Restlaenge < 128
+    uint8_t h[2], b[4] = { 0 };
+    if (mqttNet.readBytes(h, 2) != 2 || h[1] > sizeof(b) || mqttNet.readBytes(b, h[1]) != h[1]) { mqttDrop(); return; }
+    switch (h[0] >> 4) {
+      case 2:   // CONNACK
+        if (b[1] != 0) { mqttDrop(); return; }
+        mqttState = MQTT_UP; mqttRetryMs = MQTT_RETRY_MIN_MS; mqttSnapVer = pubVersion - 1; mqttPollAt = millis();
+        if (mqttPubHead(0x01, mqttTopic("online"), 0, 1)) mqttWrite("1", 1);
+        break;
+      case 4: mqttPuback(b[0] << 8 | b[1]); break;   // PUBACK
+      default: break;                                // PINGRESP
+    }
+  }
+}
+void mqttBegin() {
+  if (!MQTT_ENABLED) return;
+  WiFi.mode(apOn ? WIFI_AP_STA : WIFI_STA); WiFi.setAutoReconnect(true); WiFi.begin(SECRET_STA_SSID, SECRET_STA_PASS);
+  if (sdCardOK) mqttLoadCursor();
+}
+void mqttLoop() {
+  if (!MQTT_ENABLED) return;
+  bool sta = WiFi.status() == WL_CONNECTED;
+  if (sta) mqttStats.staMs += millis() - mqttStaLast;
+  mqttStaLast = millis();
+  if (!sta) { if (mqttState != MQTT_DOWN) mqttDrop(); return; }
+  if (mqttState == MQTT_DOWN) { if ((long)(millis() - mqttRetryAt) >= 0) mqttConnect(); return; }
+  if (!mqttNet.connected()) { mqttDrop(); return; }
+  mqttRead();
+  if (mqttState == MQTT_WAIT_CONNACK) { if (millis() - mqttSentAt > MQTT_ACK_TIMEOUT_MS) mqttDrop(); return; }
+  if (mqttState != MQTT_UP) return;
+  if (mqttSnapVer != pubVersion) {   // Schnappschuss wie /data, ein Paket je Veroeffentlichung
+    if (dataVer != pubVersion) dataBuild();
+    unsigned long t0 = micros();
+    if (!mqttPubHead(0x01, mqttTopic("data"), 0, dataLen) || !mqttWrite(dataBody, dataLen)) { mqttDrop(); return; }
+    mqttStats.ioUs += micros() - t0; mqttStats.snapshots++; mqttStats.bytes += dataLen; mqttSnapVer = pubVersion;
+  }
+  if (mqttInflightN && millis() - mqttSentAt > MQTT_ACK_TIMEOUT_MS) { if (++mqttTries > MQTT_MAX_RETRIES) { mqttDrop(); return; } mqttSendBatch(true); }
+  else if (!mqttInflightN && sdCardOK && (mqttSeenAppends != sdAppended || (long)(millis() - mqttPollAt) >= 0)) {
+    // Log nur lesen, wenn ein Datensatz dazukam, ein PUBACK weiteren Rueckstand erlaubt oder der Poll-Takt ablaeuft
+    mqttSeenAppends = sdAppended; mqttPollAt = millis() + MQTT_POLL_MS;
+    mqttSendBatch(false);
+  }
+  if (mqttState == MQTT_UP && millis() - mqttLastTx > MQTT_KEEPALIVE_S * 1000UL / 2) { uint8_t ping[2] = { 0xC0, 0 }; if (!mqttWrite(ping, 2)) mqttDrop(); }
+}
+// Durchsatz und Energie-Kennzahlen: Funkzeit im Stationsmodus, Zeit in MQTT-Ein-/Ausgabe, Bytes je Datensatz
+void handleMqtt() {
+  String j = "{\"enabled\":" + String(MQTT_ENABLED ? "true" : "false") + ",\"sta\":" + String(WiFi.status() == WL_CONNECTED ? "true" : "false")
+    + ",\"state\":" + String((int)mqttState) + ",\"broker\":\"" MQTT_HOST ":" + String(MQTT_PORT) + "\",\"cursor\":{\"session\":" + String(mqttCurSession) + ",\"seq\":" + String(mqttCurSeq)
+    + "},\"inflight\":" + String(mqttInflightN) + ",\"connects\":" + String(mqttStats.connects) + ",\"drops\":" + String(mqttStats.drops)
+    + ",\"msgs\":" + String(mqttStats.msgs) + ",\"records\":" + String(mqttStats.records) + ",\"snapshots\":" + String(mqttStats.snapshots)
+    + ",\"bytes\":" + String(mqttStats.bytes) + ",\"retries\":" + String(mqttStats.retries)
+    + ",\"ack_ms_avg\":" + String(mqttStats.msgs ? mqttStats.ackMsSum / mqttStats.msgs : 0) + ",\"ack_ms_max\":" + String(mqttStats.ackMsMax)
+    + ",\"sta_s\":" + String(mqttStats.staMs / 1000) + ",\"io_ms\":" + String(mqttStats.ioUs / 1000) + ",\"uptime_s\":" + String(millis() / 1000) + "}";
+  server.send(200, "application/json", j);
+}
+
+// --- LAUFZEIT-INVARIANTEN ---
+// Laufen immer mit (Feld und Dauertest) und zaehlen Verletzungen je Tag statt abzubrechen: Messperiode
+// ausserhalb der Toleranz, verlorene Datensaetze (Speichern fehlgeschlagen oder im Ring ueberschrieben),
+// rueckwaerts laufende Zeitstempel, Heap-Rueckgang gegenueber Tag 1 und zu kleiner groesster Block.
+// Dazu RTC-Abweichung zur GPS-Zeit und laengste loop()-Pause. Tage zaehlen nach millis() (/health).
+#define HEALTH_DAYS          8
+#define HEALTH_DAY_MS        86400000UL
+#define HEALTH_PERIOD_MS     LOG_INTERVAL_MS
+#define HEALTH_PERIOD_TOL_MS (250 + 20 * SOAK_SPEED)   // im Zeitraffer entsprechen 20 ms loop()-Latenz 20 x SOAK_SPEED ms
+#define HEALTH_HEAP_SLACK    4096
+#define HEALTH_BLOCK_MIN     16384
+struct DayHealth {
+  uint32_t day, cycles, records, lost, periodViol, backwards, heapMin, blockMin, loopMaxUs, poolFails, violations;
+  int32_t periodMaxDevMs, driftS;
+};
+DayHealth healthDays[HEALTH_DAYS];
+uint32_t healthDay = 0, healthTbUnix = 0, healthViolations = 0, healthHeapBase = 0, healthLastUnix = 0, healthOverwritten = 0, healthPoolFails = 0;
+unsigned long healthMs = 0, healthLastMillis = 0, healthLastLoopUs = 0;
+bool healthSynced = false;
+DayHealth &healthToday() { return healthDays[healthDay % HEALTH_DAYS]; }
+void healthOpenDay() { DayHealth &d = healthToday(); memset(&d, 0, sizeof(d)); d.day = healthDay; d.heapMin = d.blockMin = UINT32_MAX; d.driftS = INT32_MIN; }
+void healthViolation(DayHealth &d) { d.violations++; healthViolations++; }
+void healthCycle(unsigned long duration, const LogRecord &r, bool stored) {
+  DayHealth &d = healthToday();
+  d.cycles++;
+  if (stored) d.records++; else { d.lost++; healthViolation(d); }
+  if (ringOverwritten != healthOverwritten) { d.lost += ringOverwritten - healthOverwritten; healthOverwritten = ringOverwritten; healthViolation(d); }
+  int32_t dev = (int32_t)duration - HEALTH_PERIOD_MS;
+  if (r.seq && abs(dev) > abs(d.periodMaxDevMs)) d.periodMaxDevMs = dev;
+  if (r.seq && abs(dev) > HEALTH_PERIOD_TOL_MS) { d.periodViol++; healthViolation(d); }   // erstes Intervall endet auf dem Raster (4..12 s)
+  if (healthSynced == timeSynced && r.unixTime < healthLastUnix) { d.backwards++; healthViolation(d); }   // GPS-Sync darf einmal springen
+  healthLastUnix = r.unixTime; healthSynced = timeSynced;
+  d.heapMin = min(d.heapMin, (uint32_t)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+  d.blockMin = min(d.blockMin, (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+}
+String healthDayJSON(const DayHealth &d) {
+  return "{\"day\":" + String(d.day) + ",\"cycles\":" + String(d.cycles) + ",\"records\":" + String(d.records) + ",\"lost\":" + String(d.lost)
+    + ",\"period_viol\":" + String(d.periodViol) + ",\"period_max_dev_ms\":" + String(d.periodMaxDevMs) + ",\"backwards\":" + String(d.backwards)
+    + ",\"heap_min\":" + String(d.heapMin == UINT32_MAX ? 0 : d.heapMin) + ",\"block_min\":" + String(d.blockMin == UINT32_MAX ? 0 : d.blockMin)
+    + ",\"drift_s\":" + (d.driftS == INT32_MIN ? String("null") : String(d.driftS)) + ",\"loop_max_ms\":" + String(d.loopMaxUs / 1000.0, 1)
+    + ",\"pool_fails\":" + String(d.poolFails) + ",\"violations\":" + String(d.violations) + "}";
+}
+void healthCloseDay() {
+  DayHealth &d = healthToday();
+  uint32_t fails = ioPool.fails + nmeaPool.fails; d.poolFails = fails - healthPoolFails; healthPoolFails = fails;
+  if (d.cycles) {
+    if (!healthHeapBase) healthHeapBase = d.heapMin;
+    else if (d.heapMin + HEALTH_HEAP_SLACK < healthHeapBase) healthViolation(d);
+    if (d.blockMin < HEALTH_BLOCK_MIN) healthViolation(d);
+  }
+#ifdef NEXUS_SOAK
+  Serial.println("[SOAK] " + healthDayJSON(d));
+#endif
+  healthDay++; healthOpenDay();
+}
+void healthLoop() {
+  unsigned long us = micros(), ms = millis();
+  DayHealth &d = healthToday();
+  if (healthLastLoopUs) d.loopMaxUs = max(d.loopMaxUs, (uint32_t)(us - healthLastLoopUs));
+  healthLastLoopUs = us;
+  healthMs += ms - healthLastMillis; healthLastMillis = ms;
+  if (timeSynced && tbGps && tbUnix != healthTbUnix) { healthTbUnix = tbUnix; d.driftS = (int32_t)(rtc.now().unixtime() - utcMs(ms) / 1000); }   // einmal je GPS-Sekunde
+  if (healthMs >= HEALTH_DAY_MS) { healthMs -= HEALTH_DAY_MS; healthCloseDay(); }
+}
+void handleHealth() {
+  uint32_t n = min(healthDay + 1, (uint32_t)HEALTH_DAYS);
+  String j = "{\"day\":" + String(healthDay) + ",\"speed\":" + String(SOAK_SPEED) + ",\"violations\":" + String(healthViolations)
+    + ",\"heap_base\":" + String(healthHeapBase) + ",\"days\":[";
+  for (uint32_t i = healthDay + 1 - n; i <= healthDay; i++) { j += healthDayJSON(healthDays[i % HEALTH_DAYS]); if (i < healthDay) j += ","; }
+  server.send(200, "application/json", j + "]}");
+}
+
+#ifdef NEXUS_FAULTS
+// Auswertung der Fehlerinjektion: Zyklen, verlorene Datensaetze und groesste Periodenabweichung vor dem
+// Fahrplan, waehrend jeder Phase und danach; Erholzeit = Phasenende bis zum ersten Zyklus, der wieder
+// in der Toleranz liegt, gespeichert wurde und (je Fehler) SD/BME680/GPS-Fix zurueck hat.
+struct FaultStats { uint32_t cycles, lost; int32_t maxDevMs; };
+struct FaultResult { FaultStats during, after; long recoveryMs; };   // -1 = noch nicht erholt
+FaultStats faultBase; FaultResult faultRes[FAULT_PHASES];
+void faultAdd(FaultStats &s, int32_t dev, bool stored) { s.cycles++; if (!stored) s.lost++; if (abs(dev) > abs(s.maxDevMs)) s.maxDevMs = dev; }
+bool faultRecovered(FaultKind k, int32_t dev, bool stored) {
+  if (!stored || abs(dev) > HEALTH_PERIOD_TOL_MS) return false;
+  switch (k) {
+    case FAULT_SD_FAIL: return sdCardOK && !ringPending;
+    case FAULT_I2C_NACK: return measureTask.bmeOk;
+    case FAULT_NMEA_GARBAGE: return gps.location.isValid() && gps.location.age() < 3000;
+    default: return true;
+  }
+}
+String faultStatsJSON(const FaultStats &s) { return "{\"cycles\":" + String(s.cycles) + ",\"lost\":" + String(s.lost) + ",\"max_dev_ms\":" + String(s.maxDevMs) + "}"; }
+String faultJSON(size_t i) {
+  const FaultPhase &f = FAULT_PLAN[i]; const FaultResult &r = faultRes[i];
+  return "{\"fault\":\"" + String(FAULT_NAMES[f.kind]) + "\",\"param\":" + String(f.param) + ",\"start_s\":" + String(f.startS) + ",\"dur_s\":" + String(f.durS)
+    + ",\"during\":" + faultStatsJSON(r.during) + ",\"after\":" + faultStatsJSON(r.after)
+    + ",\"recovery_s\":" + (r.recoveryMs < 0 ? String("null") : String(r.recoveryMs / 1000.0, 1)) + "}";
+}
+void faultCycle(unsigned long duration, bool stored) {
+  if (!faultT0) { faultT0 = millis(); for (FaultResult &r : faultRes) { memset(&r, 0, sizeof(r)); r.recoveryMs = -1; } }
+  uint32_t s = (millis() - faultT0) / 1000; int32_t dev = (int32_t)duration - HEALTH_PERIOD_MS;
+  int cur = -1;   // zuletzt begonnene Phase
+  for (size_t i = 0; i < FAULT_PHASES; i++) if (s >= FAULT_PLAN[i].startS) cur = i;
+  if (cur < 0) { faultAdd(faultBase, dev, stored); return; }
+  const FaultPhase &f = FAULT_PLAN[cur]; FaultResult &r = faultRes[cur];
+  if (s < f.startS + f.durS) { faultAdd(r.during, dev, stored); return; }
+  faultAdd(r.after, dev, stored);
+  if (r.recoveryMs < 0 && faultRecovered(f.kind, dev, stored)) {
+    r.recoveryMs = (long)(millis() - faultT0) - (long)(f.startS + f.durS) * 1000;
+    Serial.println("[FAULT] " + faultJSON(cur));
+  }
+}
+void handleFaults() {
+  const char* active = "null"; uint32_t param = 0;
+  for (const FaultPhase &f : FAULT_PLAN) if (faultPhase(f.kind)) { active = FAULT_NAMES[f.kind]; param = f.param; }
+  String j = "{\"t_s\":" + String(faultT0 ? (millis() - faultT0) / 1000 : 0) + ",\"active\":" + (strcmp(active, "null") ? "\"" + String(active) + "\"" : String("null"))
+    + ",\"param\":" + String(param) + ",\"baseline\":" + faultStatsJSON(faultBase) + ",\"phases\":[";
+  for (size_t i = 0; i < FAULT_PHASES; i++) { j += faultJSON(i); if (i + 1 < FAULT_PHASES) j += ","; }
+  server.send(200, "application/json", j + "]}");
+}
+#endif
+
+// --- MESS-ZYKLUS ---
+// Die 8-s-Messung als Task: Wind/Regen werden exakt am Intervallende abgegriffen, dann laeuft die
+// BME680-Messung (Heizer + Wandlung, ca. 200 ms) im Hintergrund, waehrend loop() weiter Web, GPS und
+// Windfahne bedient. Danach werden die Werte verarbeitet und geloggt.
+void finishCycle(unsigned long duration, uint64_t centreUtc, bool bmeFresh) {
+  perfCycleClose();
+  unsigned long t0 = micros();
+  measVersion++; pubVersion++;
+  currentDewPoint = calculateDewPoint(bme.temperature, bme.humidity);
+  float p = bme.pressure / 100.0;
+
+  uint64_t tMeas = (centreUtc + duration / 2 + LOG_INTERVAL_MS / 2) / LOG_INTERVAL_MS * LOG_INTERVAL_MS;   // Messbeginn = Intervallgrenze
+  mastCycle(bmeFresh && measureTask.upperOk, p, tMeas);
+
+  LogRecord r = makeLogRecord(centreUtc, duration, bmeFresh, p);
+  // Baender einmal je Zyklus (eager) aus den gerundeten Werten des Datensatzes; Web/OLED lesen danach nur den Cache
+  alphaBands(r.temp / 100.0, r.hum / 100.0, r.pres / 10.0, alphaCache, alphaSigmaCache); alphaVer = measVersion;
+  bool stored = storeRecord(r, alphaRow(alphaCache, alphaSigmaCache));
+  healthCycle(duration, r, stored);
+  if (bmeFresh) {
+    struct __attribute__((packed)) { int16_t t; uint16_t h, p; } b = { (int16_t)lround(bme.temperature * 100), (uint16_t)lround(bme.humidity * 100), (uint16_t)lround(p * 10) };
+    mrPut(MR_BME, tMeas, &b);
+  }
+#ifdef NEXUS_FAULTS
+  faultCycle(duration, stored);
+#endif
+
+  if (gps.location.isValid()) {
+    float v[GRID_CH] = { bme.temperature, bme.humidity, currentWindSpeedAverage, alphaCache[2] };
+    gridAdd(gps.location.lat(), gps.location.lng(), v);
+  }
+  summaryAdd(duration / 1000.0, p, alphaCache, alphaSigmaCache);
+  perf.eagerUs = micros() - t0;
+  if (sunriseReached()) { endSession("Sonnenaufgang"); return; }
+  if (millis() - lastSessionSave >= SESSION_SAVE_INTERVAL) { saveSessionFiles(); lastSessionSave = millis(); }
+}
+// --- GASSENSOR (BME680) ---
+// Heizplatte nur zu Terminen auf dem UTC-Raster von GAS_EVERY_MIN Minuten, sonst spart jede Messung
+// die Heizzeit und den Heizstrom. IAQ ist eine einfache Schaetzung (nicht Boschs BSEC): 25 Punkte
+// Feuchte (optimal 40 % rF), 75 Punkte Gaswiderstand relativ zur Basislinie = hoechster Wert seit dem
+// Start, der um 1 % je Termin nachgibt (Sensordrift). 0 = sehr gute Luft, 500 = sehr schlecht; nur
+// innerhalb eines Einsatzes vergleichbar.
+uint64_t gasNextUtc = 0, gasStartUtc = 0; uint8_t gasBurstLeft = 0; bool gasHeaterOn = true;   // nach begin() an
+uint32_t gasBurns = 0; float gasBaseline = 0;
+void gasHeater(bool on) {
+  if (on == gasHeaterOn) return;
+  gasHeaterOn = on;
+  if (on) bme.setGasHeater(GAS_HEATER_C, GAS_HEATER_MS); else bme.setGasHeater(0, 0);
+}
+void gasSchedule(uint64_t now) {
+  const uint64_t every = (GAS_EVERY_MIN > 0 ? GAS_EVERY_MIN : 1) * 60000ULL;
+  if (GAS_EVERY_MIN > 0 && !gasBurstLeft && now >= gasNextUtc) { gasBurstLeft = GAS_BURST; gasNextUtc = (now / every + 1) * every; }
+  if (gasBurstLeft == 1) gasStartUtc = now;
+  gasHeater(gasBurstLeft > 0);
+}
+void gasSample(bool ok) {
+  if (!gasBurstLeft || --gasBurstLeft) return;   // nur die letzte Messung des Bursts zaehlt
+  gasBurns++;
+  if (!ok || !bme.gas_resistance) return;        // 0 = Heizplatte nicht stabil
+  gasOhm = bme.gas_resistance; gasUtc = gasStartUtc;
+  gasBaseline = gasOhm > gasBaseline ? gasOhm : gasBaseline * 0.99f + gasOhm * 0.01f;
+  float h = constrain(bme.humidity, 0.0f, 100.0f), hs = h < 40 ? 25 * h / 40 : 25 * (100 - h) / 60;
+  gasIaq = (100 - hs - 75 * min(gasOhm / gasBaseline, 1.0f)) * 5;
+  struct __attribute__((packed)) { uint32_t ohm; uint16_t iaq; } g = { gasOhm, (uint16_t)lroundf(gasIaq * 10) };
+  mrPut(MR_GAS, gasUtc, &g);
+}
+// Faellig an der Intervallgrenze. Nach einem Sprung der Zeitbasis wird die Grenze geprueft, und
+// laenger als die laengste regulaere Wartezeit (1.5 Intervalle, siehe nextLogBoundary) wird nie gewartet.
+bool measureDue(MeasureTask &t) {
+  uint64_t now = utcMs(millis());
+  if (t.epoch != tbEpoch) {   // Grenze passt nicht mehr zum neuen Anker (Sprung > 1 Intervall): neu bestimmen
+    t.epoch = tbEpoch;
+    if (t.nextUtc > now + LOG_INTERVAL_MS * 3 / 2 || t.nextUtc + LOG_INTERVAL_MS < now) t.nextUtc = nextLogBoundary(now);
+  }
+  return now >= t.nextUtc || millis() - lastLogCheck >= LOG_INTERVAL_MS * 3 / 2;
+}
+void measureRun() {
+  MeasureTask &t = measureTask;
+  TASK_BEGIN(t);
+  t.nextUtc = nextLogBoundary(utcMs(millis())); t.epoch = tbEpoch;
+  while (true) {
+    TASK_WAIT_UNTIL(t, measureDue(t));
+    t.duration = millis() - lastLogCheck;
+    lastLogCheck = millis();
+    { uint64_t now = utcMs(lastLogCheck); t.centreUtc = now - t.duration / 2; t.nextUtc = nextLogBoundary(now); }
+
+    windPoll();
+    currentWindSpeedAverage = (float)windCounts / (t.duration / 1000.0) * 0.6667;
+    windCounts = 0; windPrevCount = 0;
+    noInterrupts(); intervalRainMM = (float)rainCounts * 0.2794; rainCounts = 0; interrupts(); rainPrevCount = 0;
+    windIntervalClose();
+
+    gasSchedule(utcMs(millis()));
+    t.bmeOk = !FAULT(FAULT_I2C_NACK) && bme.beginReading() != 0;
+    t.upperOk = mastOk && bmeUpper.beginReading() != 0;   // beide Hoehen gleichzeitig
+    if (t.bmeOk || t.upperOk)
+      TASK_SLEEP(t, (unsigned long)max(max(t.bmeOk ? bme.remainingReadingMillis() : 0, t.upperOk ? bmeUpper.remainingReadingMillis() : 0), 0));
+    if (t.bmeOk) t.bmeOk = bme.endReading();
+    if (t.upperOk) t.upperOk = bmeUpper.endReading();
+    if (t.bmeOk) t.bmeUtc = utcMs(millis());
+    gasSample(t.bmeOk);
+    finishCycle(t.duration, t.centreUtc, t.bmeOk);
+  }
+  TASK_END(t);
+}
+
+// GPS-Konfiguration (Ablauf in nexus_tasks.h): Befehl per UART, Quittung aus dem NMEA-Mitschnitt
+void gpsSendCommand(const char* body) {
+  uint8_t cs = 0; for (const char* c = body; *c; c++) cs ^= *c;
+  char hex[4]; snprintf(hex, sizeof(hex), "%02X", cs);
+  Serial1.print("$"); Serial1.print(body); Serial1.print("*"); Serial1.print(hex); Serial1.print("\r\n");
+}
+struct GpsUartIo {
+  void listen(bool on) { nmeaListen = on; }
+  void drain() { nmeaDrain(); }
+  void send(const char* body) { gpsSendCommand(body); }
+  bool pending() { return nmeaHead != nmeaTail; }
+  bool next(char* buf, size_t len) { NmeaLine* l = nmeaPop(); if (!l) return false; strncpy(buf, l->s, len - 1); buf[len - 1] = 0; nmeaPool.release(l); return true; }
+} gpsUartIo;
+void gpsConfigRun() { gpsConfigStep(gpsConfigTask, gpsUartIo); }
+
+// --- SPEICHER-BERICHT ---
+// Wo liegt was? Wird beim Booten erstellt (/memory, mit -DNEXUS_BENCH auch seriell) und prueft die
+// Platzierungsregel: HOT und Tabellen im internen SRAM, BULK im PSRAM.
+enum MemClass { MEM_HOT, MEM_TABLE, MEM_BULK, MEM_ISR };
+struct MemEntry { const char* name; const void* ptr; size_t size; MemClass cls; };
+String memReport;
+const char* memRegion(const void* p) {
+  if (!p) return "-";
+  if (esp_ptr_external_ram(p)) return "PSRAM";
+  if (esp_ptr_in_drom(p)) return "FLASH";
+  if (esp_ptr_in_iram(p)) return "IRAM";
+  return esp_ptr_internal(p) ? "SRAM" : "?";
+}
+void memBuildReport() {
+  const MemEntry e[] = {
+    { "ISR countRain (Code)", (const void*)countRain, 0, MEM_ISR },
+    { "ISR-Daten Regen", (const void*)&rainCounts, sizeof(rainCounts), MEM_HOT },
+    { "ISR-Daten Regen (Zeit)", &lastRainUs, sizeof(lastRainUs), MEM_HOT },
+    { "Snapshot /data", dataBody, sizeof(dataBody), MEM_HOT },
+    { "Nacht-Zusammenfassung", &night, sizeof(night), MEM_HOT },
+    { "Windrose", roseHist, sizeof(roseHist), MEM_HOT },
+    { "Hash-Kette (Block)", &chain, sizeof(chain), MEM_HOT },
+    { "ioPool", &ioPool, sizeof(ioPool), MEM_HOT },
+    { "nmeaPool", &nmeaPool, sizeof(nmeaPool), MEM_HOT },
+    { "Tabelle Ziffernpaare", DIGIT_PAIRS, sizeof(DIGIT_PAIRS), MEM_TABLE },
+    { "Tabelle CRC-32", CRC_NIBBLE, sizeof(CRC_NIBBLE), MEM_TABLE },
+    { "Tabelle Geohash", GEOHASH_B32, sizeof(GEOHASH_B32), MEM_TABLE },
+    { "Raster-Schluessel", gridKeys, GRID_SLOTS * sizeof(uint64_t), MEM_BULK },
+    { "Raster-Zellen", gridCells, GRID_SLOTS * sizeof(GridCell), MEM_BULK },
+    { "Multi-Rate-Puffer", mrBuf, MR_STREAMS * sizeof(MrBuf), MEM_BULK },
+    { "Multi-Rate-Index", mrIndex, MR_INDEX_MAX * sizeof(MrIndexEntry), MEM_BULK },
+  };
+  const char* CLS[] = { "HOT", "TAB", "BULK", "ISR" };
+  memReport = "NEXUS Speicherplatzierung\n";
+  char line[96];
+  for (const MemEntry &m : e) {
+    const char* r = memRegion(m.ptr);
+    bool ok = m.ptr && (m.cls == MEM_ISR ? esp_ptr_in_iram(m.ptr) : m.cls == MEM_BULK ? esp_ptr_external_ram(m.ptr) : !esp_ptr_external_ram(m.ptr) && !esp_ptr_in_drom(m.ptr));
+    snprintf(line, sizeof(line), "%-24s %4s %7u B  %-6s %s\n", m.name, CLS[m.cls], (unsigned)m.size, r, ok ? "ok" : "!!");
+    memReport += line;
+  }
+  snprintf(line, sizeof(line), "Heap intern: %u B frei (groesster Block %u B), PSRAM: %u B frei\n", (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+    (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL), (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+  memReport += line;
+}
+
+// --- BENCHMARK (nur mit -DNEXUS_BENCH) ---
+// Misst beim Booten mit dem CPU-Zyklenzaehler und gibt die Ergebnisse seriell aus (115200 Baud).
+#ifdef NEXUS_BENCH
+#define BENCH_RUNS 1000
+Task benchTask; uint32_t benchYields = 0; TaskHandle_t benchMain;
+void benchYieldRun() { TASK_BEGIN(benchTask); while (true) { benchYields++; TASK_YIELD(benchTask); } TASK_END(benchTask); }
+void benchPong(void*) { for (;;) { ulTaskNotifyTake(pdTRUE, portMAX_DELAY); xTaskNotifyGive(benchMain); } }
+void benchReport(const char* name, uint32_t cycles) { Serial.printf("[BENCH] %-28s %8lu Zyklen/Aufruf\n", name, (unsigned long)(cycles / BENCH_RUNS)); }
+// Gleiches Zugriffsmuster auf eine Kopie im internen SRAM und im PSRAM: Kosten je Strukturgroesse
+void benchPlacement(const char* name, size_t size, bool random) {
+  uint8_t* in = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT), *ex = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+  uint32_t c[2] = { 0, 0 }; uint8_t* bufs[2] = { in, ex }; volatile uint32_t sink = 0;
+  for (int b = 0; b < 2; b++) {
+    if (!bufs[b]) continue;
+    memset(bufs[b], 1, size); uint32_t words = size / 4, x = 12345, t0 = ESP.getCycleCount();
+    for (uint32_t i = 0; i < BENCH_RUNS; i++) { uint32_t idx = random ? (x = x * 1103515245 + 12345) >> 8 : i * 8; sink += ((uint32_t*)bufs[b])[idx % words]; }
+    c[b] = ESP.getCycleCount() - t0;
+  }
+  Serial.printf("[BENCH] %-24s %7u B %s  SRAM %5lu  PSRAM %5lu Zyklen/1000 Zugriffe\n", name, (unsigned)size, random ? "zufaellig " : "sequentiell",
+    in ? (unsigned long)c[0] : 0UL, ex ? (unsigned long)c[1] : 0UL);
+  heap_caps_free(in); heap_caps_free(ex);
+}
+void runBenchmarks() {
+  LogRecord r = { 1234, 1773610455, 1584, 6439, 10132, 210, 380, 217, 0, 517185340, 87543210, REC_FIX, 3, 12, 0, 0, 800, 420, -35 };
+  char buf[CSV_ROW_MAX]; volatile int sink = 0; uint32_t t0;
+  float a[5], u[5]; alphaBands(r.temp / 100.0, r.hum / 100.0, r.pres / 10.0, a, u); AlphaRow ab = alphaRow(a, u);
+  t0 = ESP.getCycleCount();
+  for (int i = 0; i < BENCH_RUNS; i++) { r.temp = 1584 + (i & 7); sink += formatCSVRow(r, ab, buf, sizeof(buf)); }
+  benchReport("CSV-Zeile (Tabellen)", ESP.getCycleCount() - t0);
+  t0 = ESP.getCycleCount();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    r.temp = 1584 + (i & 7); DateTime t(r.unixTime);
+    sink += snprintf(buf, sizeof(buf), "%02d.%02d.%02d,%02d:%02d:%02d,%.2f,%.1f,%.1f,%.2f,%.2f,%d,%.6f,%.6f\n", t.day(), t.month(), t.year(), t.hour(), t.minute(), t.second(),
+      r.temp / 100.0, r.hum / 100.0, r.pres / 10.0, r.wind / 100.0, r.gust / 100.0, r.dir, r.lat / 1e7, r.lon / 1e7);
+  }
+  benchReport("CSV-Zeile (snprintf)", ESP.getCycleCount() - t0);
+
+  // Daempfung: float vs. Dual (Wert + 3 Ableitungen) -> Kostenfaktor der Fehlerfortpflanzung
+  volatile float fsink = 0;
+  t0 = ESP.getCycleCount();
+  for (int i = 0; i < BENCH_RUNS; i++) fsink = fsink + calculateAlphaISO(40000.0, 15.0f + (i & 7), 70.0f, 1013.0f);
+  benchReport("Daempfung (float)", ESP.getCycleCount() - t0);
+  t0 = ESP.getCycleCount();
+  for (int i = 0; i < BENCH_RUNS; i++) fsink = fsink + dualSigma(calculateAlphaISO(40000.0, Dual::var(15.0f + (i & 7), 0), Dual::var(70.0f, 1), Dual::var(1013.0f, 2)));
+  benchReport("Daempfung (Dual + sigma)", ESP.getCycleCount() - t0);
+
+  // Block-Pool vs. Heap (1-KB-Puffer, wie in den Web-Handlern)
+  t0 = ESP.getCycleCount();
+  for (int i = 0; i < BENCH_RUNS; i++) { IoBuf* b = ioPool.alloc(); b->b[0] = i; sink += b->b[0]; ioPool.release(b); }
+  benchReport("1 KB Block-Pool", ESP.getCycleCount() - t0);
+  t0 = ESP.getCycleCount();
+  for (int i = 0; i < BENCH_RUNS; i++) { uint8_t* b = (uint8_t*)malloc(sizeof(IoBuf)); b[0] = i; sink += b[0]; free(b); }
+  benchReport("1 KB malloc/free", ESP.getCycleCount() - t0);
+
+  // Taskwechsel: Protothread-Fortsetzung vs. FreeRTOS-Kontextwechsel (Notify-Pingpong, 2 Wechsel pro Runde)
+  t0 = ESP.getCycleCount();
+  for (int i = 0; i < BENCH_RUNS; i++) benchYieldRun();
+  benchReport("Task-Wechsel (Protothread)", ESP.getCycleCount() - t0);
+  benchMain = xTaskGetCurrentTaskHandle(); TaskHandle_t peer;
+  xTaskCreatePinnedToCore(benchPong, "bench", 2048, nullptr, uxTaskPriorityGet(nullptr), &peer, xPortGetCoreID());
+  t0 = ESP.getCycleCount();
+  for (int i = 0; i < BENCH_RUNS; i++) { xTaskNotifyGive(peer); ulTaskNotifyTake(pdTRUE, portMAX_DELAY); }
+  benchReport("Task-Wechsel (FreeRTOS x2)", ESP.getCycleCount() - t0);
+  vTaskDelete(peer);
+  // Platzierung: jede Struktur einmal intern und einmal im PSRAM (Raster nur, wenn intern Platz ist)
+  benchPlacement("Snapshot /data", sizeof(dataBody), true);
+  benchPlacement("Nacht-Zusammenfassung", sizeof(night), true);
+  benchPlacement("Windrose", sizeof(roseHist), true);
+  benchPlacement("Tabelle Ziffernpaare", sizeof(DIGIT_PAIRS), true);
+  benchPlacement("ioPool", sizeof(ioPool), false);
+  benchPlacement("Raster-Schluessel", GRID_SLOTS * sizeof(uint64_t), false);
+  benchPlacement("Raster-Schluessel", GRID_SLOTS * sizeof(uint64_t), true);
+  benchPlacement("Raster-Zellen", GRID_SLOTS * sizeof(GridCell), true);
+  Serial.print(memReport);
+  Serial.printf("[BENCH] Sketch-Groesse: %lu Bytes\n", (unsigned long)ESP.getSketchSize());
+}
+#endif
+
+// --- STRESSTEST (nur mit -DNEXUS_STRESS) ---
+// 100-Hz-Rechteck per LEDC auf beide Impulseingaenge (intern zurueckgelesen, Sensoren abklemmen),
+// waehrenddessen Loeschen/Schreiben eines Flash-Sektors hinter dem Ring-Puffer (Flash-Cache aus).
+// Erwartung: Wind = 100 Impulse/s exakt (PCNT), Regen = 1 Impuls je 210 ms (Entprellung 200 ms, Raster 10 ms).
+#ifdef NEXUS_STRESS
+#define STRESS_HZ       100
+#define STRESS_SECONDS  10
+void runPulseStress() {
+  if (!ringPart || ringPart->size < RING_BYTES + RING_SECTOR) { Serial.println("[STRESS] Kein freier Flash-Sektor hinter dem Ring-Puffer"); return; }
+  const int pins[2] = { PIN_WIND_SPD, PIN_RAIN };
+  for (int i = 0; i < 2; i++) {
+    ledcSetup(i, STRESS_HZ, 10); ledcAttachPin(pins[i], i);
+    gpio_set_direction((gpio_num_t)pins[i], GPIO_MODE_INPUT_OUTPUT);   // Ausgang und Eingang (PCNT/ISR) am selben Pin
+  }
+  static uint8_t page[256]; memset(page, 0xA5, sizeof(page));
+  windPoll(); windCounts = 0; rainCounts = 0;
+  for (int i = 0; i < 2; i++) ledcWrite(i, 512);
+  int64_t t0 = esp_timer_get_time(), worst = 0; uint32_t ops = 0, bytes = 0;
+  while (esp_timer_get_time() - t0 < STRESS_SECONDS * 1000000LL) {
+    int64_t s = esp_timer_get_time();
+    esp_partition_erase_range(ringPart, RING_BYTES, RING_SECTOR);
+    for (size_t o = 0; o < RING_SECTOR; o += sizeof(page)) esp_partition_write(ringPart, RING_BYTES + o, page, sizeof(page));
+    worst = max(worst, esp_timer_get_time() - s); ops++; bytes += RING_SECTOR;
+    windPoll(); esp_task_wdt_reset();
+  }
+  for (int i = 0; i < 2; i++) { ledcWrite(i, 0); ledcDetachPin(pins[i]); }
+  int64_t dt = esp_timer_get_time() - t0;
+  windPoll();
+  uint32_t expWind = (uint32_t)(dt * STRESS_HZ / 1000000), expRain = (uint32_t)(dt / (RAIN_DEBOUNCE_US + 1000000 / STRESS_HZ));
+  bool ok = labs((long)windCounts - (long)expWind) <= 1 && labs((long)rainCounts - (long)expRain) <= 1;
+  Serial.printf("[STRESS] %u Flash-Zyklen (%u KB), laengster %lld us\n", (unsigned)ops, (unsigned)(bytes / 1024), (long long)worst);
+  Serial.printf("[STRESS] Wind  %lu / erwartet %lu\n[STRESS] Regen %lu / erwartet %lu\n[STRESS] %s\n",
+    (unsigned long)windCounts, (unsigned long)expWind, (unsigned long)rainCounts, (unsigned long)expRain, ok ? "BESTANDEN" : "FEHLGESCHLAGEN");
+  esp_partition_erase_range(ringPart, RING_BYTES, RING_SECTOR);
+  pinMode(PIN_WIND_SPD, INPUT_PULLUP); pinMode(PIN_RAIN, INPUT_PULLUP); gpio_set_intr_type((gpio_num_t)PIN_RAIN, GPIO_INTR_NEGEDGE);
+  windCounts = 0; rainCounts = 0;
+}
+#endif
+
+#ifdef NEXUS_SOAK
+// Simuliert je virtueller Sekunde: RMC+GGA eines Transekts um Paderborn (in TinyGPS++ eingespeist),
+// Anemometer-/Regenimpulse und den Bediener (Session abends starten, nach Sonnenaufgang neu).
+uint32_t soakLastSec = 0; double soakLat = 51.7185, soakLon = 8.7543; float soakWindCarry = 0;
+void soakNmea(const char* body) {
+  uint8_t cs = 0; for (const char* c = body; *c; c++) cs ^= *c;
+  char line[100]; snprintf(line, sizeof(line), "$%s*%02X\r\n", body, cs);
+  for (const char* c = line; *c; c++) gps.encode(faultNmea(*c));
+}
+void soakTick() {
+  uint32_t u = soakUnix();
+  if (u != soakLastSec) {
+    soakLastSec = u; DateTime t(u); char b[90];
+    soakLat = constrain(soakLat + 0.00002 * soakNoise(), 51.713, 51.724); soakLon = constrain(soakLon + 0.00003 * soakNoise(), 8.746, 8.762);
+    double la = fabs(soakLat), lo = fabs(soakLon);
+    int laD = (int)la, loD = (int)lo; double laM = (la - laD) * 60, loM = (lo - loD) * 60;
+    snprintf(b, sizeof(b), "GPRMC,%02d%02d%02d.00,A,%02d%08.5f,N,%03d%08.5f,E,0.5,0.0,%02d%02d%02d,,,A", t.hour(), t.minute(), t.second(), laD, laM, loD, loM, t.day(), t.month(), t.year() % 100);
+    soakNmea(b);
+    snprintf(b, sizeof(b), "GPGGA,%02d%02d%02d.00,%02d%08.5f,N,%03d%08.5f,E,1,09,0.9,112.0,M,47.0,M,,", t.hour(), t.minute(), t.second(), laD, laM, loD, loM);
+    soakNmea(b);
+    float ws = max(0.0f, 3 + 2 * sinf(u / 5400.0f) + 1.5f * soakNoise());
+    soakWindCarry += ws / 0.6667; uint32_t n = (uint32_t)soakWindCarry; soakWindCarry -= n; windCounts += n;
+    if ((u / 86400) % 3 == 1 && esp_random() % 50 == 0) { noInterrupts(); rainCounts++; interrupts(); }   // jeder dritte Tag verregnet
+  }
+  if (appState == 0 || appState == 1) { cloudCover = 3; isStationary = false; appState = 2; lastButtonPress = millis(); startSession(); }
+  else if (appState == 3 && (u % 86400) / 3600 == 17) appState = 0;
+}
+#endif
+
 // --- SETUP ---
 void setup() {
+#if defined(NEXUS_BENCH) || defined(NEXUS_STRESS) || defined(NEXUS_SOAK)
+  Serial.begin(115200);
+#endif
   Wire.begin();
   u8g2.begin(); u8g2.setFont(u8g2_font_ncenB08_tr);
   u8g2.clearBuffer(); u8g2.drawStr(10, 30, "NEXUS INITIALIZING..."); u8g2.sendBuffer();
 
-  bme.begin(ADDR_BME); rtc.begin(); expander.begin();
+  bme.begin(ADDR_BME); gasHeater(false); rtc.begin(); expander.begin();
+  mastOk = bmeUpper.begin(ADDR_BME_UPPER); if (mastOk) bmeUpper.setGasHeater(0, 0);
   Serial1.begin(9600, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
-  pinMode(PIN_WIND_SPD, INPUT_PULLUP); attachInterrupt(digitalPinToInterrupt(PIN_WIND_SPD), countWind, FALLING);
-  pinMode(PIN_RAIN, INPUT_PULLUP); attachInterrupt(digitalPinToInterrupt(PIN_RAIN), countRain, FALLING);
+  pulseBegin();
 
-  WiFi.softAP(SECRET_SSID, SECRET_PASS);
+  stationId = (uint32_t)ESP.getEfuseMac(); bootNonce = esp_random();
+  if (WIFI_AP_AT_BOOT) apSet(true); else esp_netif_init();   // TCP/IP-Stack auch ohne AP (Loopback fuer USB)
   server.on("/", [](){ server.send(200, "text/html", boot_page); });
   server.on("/interface", [](){ server.send(200, "text/html", getHTML()); });
-  server.on("/data", [](){
-    String j = "{ \"mode\":\"" + String(isStationary ? "STAT" : "MOB") + "\", \"temp\":" + String(bme.temperature) + ", \"hum\":" + String(bme.humidity) + ", \"dew\":" + String(currentDewPoint) + ", \"pres\":" + String(bme.pressure/100.0) + ", \"w_avg\":" + String(currentWindSpeedAverage) + ", \"w_gst\":" + String(displayWindGust) + ", \"w_dir\":\"" + currentWindDirText + "\", \"rain\":" + String(intervalRainMM) + ", \"a20\":" + String(val_a20) + ", \"a40\":" + String(val_a40) + ", \"a55\":" + String(val_a55) + ", \"a80\":" + String(val_a80) + ", \"a110\":" + String(val_a110) + ", \"gps_v\":" + String(gps.location.isValid() ? "true" : "false") + ", \"lat\":" + String(gps.location.lat(), 6) + ", \"lon\":" + String(gps.location.lng(), 6) + ", \"alt\":" + String(gps.altitude.meters()) + ", \"sats\":" + String(gps.satellites.value()) + ", \"synced\":" + (timeSynced?"true":"false") + " }";
-    server.send(200, "application/json", j);
+  server.on("/data", handleData);
+  server.on("/grid", [](){ handleGrid(false); });
+  server.on("/grid.csv", [](){ handleGrid(true); });
+  server.on("/windrose", [](){ server.send(200, "application/json", roseJSON()); });
+  server.on("/windrose.bin", [](){ static uint8_t b[8 + 16 + sizeof(roseHist)]; size_t n = roseBinary(b); server.send(200, "application/octet-stream", b, n); });
+  server.on("/summary", [](){
+    if (server.arg("fmt") == "txt") server.send(200, "text/plain; charset=utf-8", summaryText());
+    else server.send(200, "application/json", summaryJSON());
   });
+  server.on("/storage", handleStorage);
+  server.on("/chain", handleChain);
+  server.on("/memory", [](){ server.send(200, "text/plain; charset=utf-8", memReport); });
+  server.on("/perf", handlePerf);
+  server.on("/health", handleHealth);
+#ifdef NEXUS_FAULTS
+  server.on("/faults", handleFaults);
+#endif
+  server.on("/sync", handleSync);
+  server.on("/sync/sessions", handleSyncSessions);
+  server.on("/export/gpx", [](){ handleExport(false); });
+  server.on("/export/kml", [](){ handleExport(true); });
+  server.on("/link", handleLink);
+  server.on("/mqtt", handleMqtt);
+  const char* hdrs[] = { "If-None-Match" }; server.collectHeaders(hdrs, 1);
   server.begin();
+#if USB_LINK
+  usbLinkBegin();
+#endif
+#if BLE_STATUS
+  bleBegin();
+#endif
+  gridBegin(); mrBegin();
   sdCardOK = SD.begin(PIN_SD_CS);
+  mqttBegin();
+  ringBegin();
+  memBuildReport();
+  healthLastMillis = millis(); healthOpenDay();
+#ifdef NEXUS_BENCH
+  runBenchmarks();
+#endif
+#ifdef NEXUS_STRESS
+  runPulseStress();
+#endif
   delay(1000);
 }
 
 // --- LOOP ---
 void loop() {
-  server.handleClient();
-  while (Serial1.available() > 0) { gps.encode(Serial1.read()); }
-  if (!timeSynced) syncRTCToGPS();
+  healthLoop();
+#ifdef NEXUS_SOAK
+  soakTick();
+#endif
+  server.handleClient(); linkLoop(); mqttLoop();
+  while (Serial1.available() > 0) { char c = faultNmea(Serial1.read()); gps.encode(c); nmeaCollect(c); }
+  timebaseUpdate();
+  mrGpsSample();
+  gpsConfigRun();
+  if (!timeSynced) { syncRTCToGPS(); if (timeSynced) pubVersion++; }
+  if (appState != 2 && millis() - lastIdlePublish >= DATA_PUBLISH_IDLE_MS) { pubVersion++; lastIdlePublish = millis(); }
+  sdRetry(); ringMigrate();
+  if (chainSealPending && sdCardOK && !ringPending && millis() - lastChainSeal >= CHAIN_SEAL_RETRY) { lastChainSeal = millis(); chainSeal(chainSealPending); }
 
   if (appState == 0) { // OKTAS WAHL
     int val = expander.read8(); int clk = (val >> 0) & 1;
@@ -203,46 +2512,32 @@ void loop() {
     u8g2.clearBuffer(); u8g2.drawStr(40, 12, "MODUS"); u8g2.setCursor(20, 35); u8g2.print(isStationary ? ">> STATIONAER <<" : ">> MOBIL <<"); u8g2.sendBuffer();
     if (((val >> 2) & 1) == 0 && millis() - lastButtonPress > 500) { 
         appState = 2; lastButtonPress = millis(); 
-        if (sdCardOK) {
-            DateTime now = rtc.now();
-            logFileName = "/" + pad(now.day()) + pad(now.month()) + String(now.year()).substring(2) + "-" + pad(now.hour()) + pad(now.minute()) + ".csv";
-            File f = SD.open(logFileName, FILE_WRITE);
-            if (f) { f.println("Date,Time,Temp,Hum,Pres,WindAvg,WindGust,Lat,Lon"); f.close(); }
-        }
+        startSession();
     }
   }
   else if (appState == 2) { // MESS-INTERVALL (8 SEKUNDEN)
-    if (millis() - lastLogCheck >= 8000) {
-      unsigned long duration = millis() - lastLogCheck;
-      lastLogCheck = millis();
-      bme.performReading();
-      currentDewPoint = calculateDewPoint(bme.temperature, bme.humidity);
-      float p = bme.pressure / 100.0;
-      
-      val_a20 = calculateAlphaISO(20000.0, bme.temperature, bme.humidity, p);
-      val_a40 = calculateAlphaISO(40000.0, bme.temperature, bme.humidity, p);
-      val_a110 = calculateAlphaISO(110000.0, bme.temperature, bme.humidity, p);
-
-      noInterrupts();
-      float ticksPerSec = (float)windCounts / (duration / 1000.0);
-      currentWindSpeedAverage = ticksPerSec * 0.6667; 
-      intervalRainMM = (float)rainCounts * 0.2794;
-      windCounts = 0; rainCounts = 0;
-      interrupts();
-
-      u8g2.clearBuffer();
-      u8g2.setCursor(0, 12); u8g2.print("T: "); u8g2.print(bme.temperature, 1); u8g2.print("C  H: "); u8g2.print(bme.humidity, 0); u8g2.print("%");
-      u8g2.setCursor(0, 32); u8g2.print("P: "); u8g2.print(p, 0); u8g2.print("hPa DP: "); u8g2.print(currentDewPoint, 1);
-      u8g2.setCursor(0, 55); 
-      if (isStationary) u8g2.print("WIND: " + String(currentWindSpeedAverage, 1) + " m/s");
-      else { if (gps.location.isValid()) { u8g2.print(gps.location.lat(), 4); u8g2.print(" "); u8g2.print(gps.location.lng(), 4); } else u8g2.print("WAIT FOR GPS..."); }
-      u8g2.sendBuffer();
-
-      if (sdCardOK) {
-        DateTime now = rtc.now();
-        File f = SD.open(logFileName, FILE_APPEND);
-        if (f) { f.printf("%02d.%02d.%02d,%02d:%02d:%02d,%.2f,%.1f,%.1f,%.2f,%.6f,%.6f\n", now.day(), now.month(), now.year(), now.hour(), now.minute(), now.second(), bme.temperature, bme.humidity, p, currentWindSpeedAverage, gps.location.lat(), gps.location.lng()); f.close(); }
-      }
+    if (millis() - lastButtonPoll >= 100) { // Langer Druck (3 s) beendet die Session
+      lastButtonPoll = millis();
+      if (((expander.read8() >> 2) & 1) == 0) { oledWake(); if (!buttonDownSince) buttonDownSince = millis(); else if (millis() - buttonDownSince >= LONG_PRESS_MS) { buttonDownSince = 0; lastButtonPress = millis(); endSession("manuell"); return; } }
+      else buttonDownSince = 0;
+    }
+    uint64_t nowUtc = utcMs(millis());   // auf vollen UTC-Sekunden, nach Sprung der Zeitbasis neu ausrichten
+    if (roseEpoch != tbEpoch) { roseEpoch = tbEpoch; roseNextUtc = (nowUtc / 1000 + 1) * 1000; }
+    if (nowUtc >= roseNextUtc || millis() - lastRoseSample >= 2000) {
+      if (roseSample((millis() - lastRoseSample) / 1000.0)) lastRoseSample = millis();
+      roseNextUtc = (utcMs(millis()) / 1000 + 1) * 1000;
     }
+    measureRun();
+    oledRun();
+  }
+  else if (appState == 3) { // SESSION BEENDET
+    int val = expander.read8();
+    u8g2.clearBuffer(); u8g2.drawStr(20, 12, "SESSION ENDE");
+    u8g2.setCursor(0, 26); u8g2.print("T "); u8g2.print(night.temp.min, 1); u8g2.print(".."); u8g2.print(night.temp.max, 1); u8g2.print("C");
+    u8g2.setCursor(0, 38); u8g2.print("Regen "); u8g2.print(night.rainMM, 1); u8g2.print("mm  "); u8g2.print(night.records); u8g2.print(" Z.");
+    u8g2.setCursor(0, 50); u8g2.print(chainSealPending ? "# " : "#SIG "); u8g2.print(chainHeadHex(6));
+    u8g2.drawStr(10, 62, "< Druecken: Neu >"); u8g2.sendBuffer();
+    if (((val >> 2) & 1) == 1) buttonReleased = true; // erst loslassen (Langdruck), dann neu druecken
+    else if (buttonReleased && millis() - lastButtonPress > 500) { appState = 0; lastButtonPress = millis(); }
   }
 }
@@ -0,0 +1,57 @@
+/*
+ * NEXUS - Kooperative Tasks und GPS-Konfiguration
+ * ---------------------------------------------------------------------
+ * Copyright (C) 2025-2026 Jochen Roth
+ * Licensed under Creative Commons Attribution-NonCommercial 4.0
+ * ---------------------------------------------------------------------
+ * Ohne Arduino-Abhaengigkeit, damit software/tests/ die Makros und die GPS-Quittungslogik auf dem
+ * Host pruefen kann. Vor dem Einbinden muss millis() deklariert sein (Arduino.h bzw. Test-Attrappe);
+ * mit -DNEXUS_SOAK erst nach "#define millis() soakMillis()", sonst laufen Task- und GPS-Zeitgrenzen in Echtzeit.
+ */
+#pragma once
+#include <string.h>
+
+// --- KOOPERATIVE TASKS ---
+// Stackless "Protothreads": Eine Task ist eine Funktion, deren Zustand im Task-Objekt liegt und die
+// bei jedem Aufruf an ihrer letzten Warte-Stelle weitermacht (switch auf __LINE__). Kein eigener
+// Stack, kein Heap, ein Taskwechsel ist ein normaler Funktionsaufruf aus loop().
+// Achtung: lokale Variablen ueberleben ein Warten NICHT (-> ins Task-Objekt), und im Task-Rumpf
+// darf kein eigenes switch stehen.
+struct Task { int line = 0; unsigned long since = 0, dur = 0; };
+#define TASK_BEGIN(t)          switch ((t).line) { case 0:
+#define TASK_YIELD(t)          do { (t).line = __LINE__; return; case __LINE__:; } while (0)
+#define TASK_WAIT_UNTIL(t, c)  do { (t).line = __LINE__; case __LINE__: if (!(c)) return; } while (0)
+#define TASK_SLEEP(t, ms)      do { (t).since = millis(); (t).dur = (ms); TASK_WAIT_UNTIL(t, millis() - (t).since >= (t).dur); } while (0)
+#define TASK_END(t)            } (t).line = -1   // fertig: weitere Aufrufe tun nichts mehr
+#define TASK_DONE(t)           ((t).line == -1)
+#define TASK_RESTART(t)        ((t).line = 0)
+
+// --- GPS-KONFIGURATION ---
+// AIR530 (GOKE): nur RMC + GGA ausgeben (mehr braucht TinyGPS++ nicht), Quittung "$PGKC001,242,3"
+// abwarten, bis zu 3 Versuche. Entlastet UART und Parser um GSV/GSA/VTG/GLL.
+// Die Ein-/Ausgabe kommt ueber Io: listen(bool), drain(), send(body), pending(), next(buf, len)
+// (naechste mitgeschnittene NMEA-Zeile kopieren, false = keine da).
+#define GPS_CONFIG_RETRIES 3
+#define GPS_CONFIG_BOOT_MS 1500   // Modul nach dem Einschalten hochfahren lassen
+#define GPS_CONFIG_ACK_MS  1000   // Wartezeit je Versuch
+#define GPS_CONFIG_CMD     "PGKC242,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0"
+#define GPS_CONFIG_ACK     "$PGKC001,242,3"
+#define GPS_LINE_MAX       96
+struct GpsConfigTask : Task { int attempt; unsigned long sent; bool ok; };
+template <class Io> void gpsConfigStep(GpsConfigTask &t, Io &io) {
+  char line[GPS_LINE_MAX];
+  TASK_BEGIN(t);
+  TASK_SLEEP(t, GPS_CONFIG_BOOT_MS);
+  io.listen(true);
+  for (t.attempt = 0; t.attempt < GPS_CONFIG_RETRIES && !t.ok; t.attempt++) {
+    io.drain();
+    io.send(GPS_CONFIG_CMD);
+    t.sent = millis();
+    while (!t.ok && millis() - t.sent < GPS_CONFIG_ACK_MS) {
+      TASK_WAIT_UNTIL(t, io.pending() || millis() - t.sent >= GPS_CONFIG_ACK_MS);
+      while (!t.ok && io.next(line, sizeof(line))) t.ok = strncmp(line, GPS_CONFIG_ACK, sizeof(GPS_CONFIG_ACK) - 1) == 0;
+    }
+  }
+  io.listen(false); io.drain();
+  TASK_END(t);
+}
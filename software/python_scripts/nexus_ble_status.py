@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - BLE Status
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: Encodes and decodes the 20-byte BLE status of the station and
+         the control commands (access point on/off). `decode` takes the
+         hex value from a BLE app (e.g. nRF Connect) or from /link,
+         `watch` and `ap` talk to the station directly (needs `bleak`),
+         `budget` compares the estimated night charge of BLE with the AP
+         on demand against an AP running all night.
+         / Kodiert und dekodiert den 20-Byte-BLE-Status der Station und
+         die Steuerbefehle (Access Point an/aus). `decode` nimmt den
+         Hex-Wert aus einer BLE-App (z. B. nRF Connect) oder aus /link,
+         `watch` und `ap` sprechen direkt mit der Station (braucht
+         `bleak`), `budget` vergleicht die geschätzte Ladung einer Nacht
+         mit BLE und AP auf Abruf gegen einen AP, der die ganze Nacht läuft.
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import asyncio
+import json
+import struct
+import sys
+import urllib.request
+
+# --- BLE protocol (must match main.cpp) / BLE-Protokoll (wie in main.cpp) ---
+SERVICE_UUID = "6e580001-7c2a-4b5e-9d1f-4e4558555301"
+STATUS_UUID = "6e580002-7c2a-4b5e-9d1f-4e4558555301"
+CONTROL_UUID = "6e580003-7c2a-4b5e-9d1f-4e4558555301"
+STATUS = struct.Struct("<BB3sHBHhBHBBBH")            # BleStatus, 20 Bytes
+STATUS_VERSION = 1
+FLAGS = ["logging", "sd_ok", "gps_fix", "time_synced", "ap_on", "stationary", "bme_stale", "ap_on_demand"]
+COMMANDS = {"ap_off": 0, "ap_on": 1, "refresh": 2}
+
+# Typische Stromaufnahme der Station in mA (ESP32-S3 bei 240 MHz, Sensoren, OLED aus) - am eigenen
+# Aufbau nachmessen und per --i-* übergeben
+I_BASE_MA = 45.0                                     # Funk aus
+I_AP_MA = 65.0                                       # zusätzlich: Soft-AP (Beacons, kein Modem-Sleep)
+I_BLE_MA = 4.0                                       # zusätzlich: BLE, 1 s Advertising, gelegentlich verbunden
+
+
+def decode_status(raw: bytes) -> dict:
+    """20 bytes -> physical values. / 20 Bytes -> physikalische Werte."""
+    if len(raw) != STATUS.size:
+        raise ValueError(f"status must be {STATUS.size} bytes, got {len(raw)}")
+    ver_sats, flags, rec, ring, sdf, vbat, temp, hum, pres, wind, gust, direction, rain = STATUS.unpack(raw)
+    if ver_sats >> 5 != STATUS_VERSION:
+        raise ValueError(f"unknown status version {ver_sats >> 5}")
+    out = {name: bool(flags & (1 << i)) for i, name in enumerate(FLAGS)}
+    out.update(sats=ver_sats & 31, records=int.from_bytes(rec, "little"), ring_pending=ring, sd_failures=sdf,
+               vbat_v=vbat / 1000.0 if vbat else None, temp_c=temp / 100.0, hum_pct=hum / 2.0, pres_hpa=pres / 10.0,
+               wind_ms=wind / 10.0, gust_ms=gust / 10.0, dir_deg=None if direction == 255 else direction * 2,
+               rain_mm=rain / 100.0)
+    return out
+
+
+def encode_status(s: dict) -> bytes:
+    """Inverse of decode_status (e.g. for a simulated station). / Umkehrung von decode_status."""
+    flags = sum(1 << i for i, name in enumerate(FLAGS) if s.get(name))
+    clamp = lambda v, hi: max(0, min(hi, int(round(v))))
+    return STATUS.pack(STATUS_VERSION << 5 | min(s.get("sats", 0), 31), flags, clamp(s.get("records", 0), 0xFFFFFF).to_bytes(3, "little"),
+                       clamp(s.get("ring_pending", 0), 65535), clamp(s.get("sd_failures", 0), 255),
+                       clamp((s.get("vbat_v") or 0) * 1000, 65535), int(round(s.get("temp_c", 0) * 100)),
+                       clamp(s.get("hum_pct", 0) * 2, 200), clamp(s.get("pres_hpa", 0) * 10, 65535),
+                       clamp(s.get("wind_ms", 0) * 10, 255), clamp(s.get("gust_ms", 0) * 10, 255),
+                       255 if s.get("dir_deg") is None else clamp(s["dir_deg"] / 2, 179), clamp(s.get("rain_mm", 0) * 100, 65535))
+
+
+def encode_command(name: str) -> bytes:
+    return bytes([COMMANDS[name]])
+
+
+def show(s: dict) -> str:
+    state = "LOGGT" if s["logging"] else "bereit"
+    sd = "SD ok" if s["sd_ok"] else f"SD AUSFALL ({s['ring_pending']} im Flash-Ring)"
+    d = "Flaute" if s["dir_deg"] is None else f"{s['dir_deg']}°"
+    bat = f", Akku {s['vbat_v']:.2f} V" if s["vbat_v"] else ""
+    ap = ", AP an" + (" (auf Abruf)" if s["ap_on_demand"] else "") if s["ap_on"] else ""
+    return (f"{state}, {s['records']} Datensätze, {sd}{bat}{ap} | {s['temp_c']:.1f} °C, {s['hum_pct']:.0f} %, "
+            f"{s['pres_hpa']:.1f} hPa, Wind {s['wind_ms']:.1f} (Böe {s['gust_ms']:.1f}) m/s {d}, Regen {s['rain_mm']:.2f} mm, "
+            f"{s['sats']} Sat." + (" BME VERALTET" if s["bme_stale"] else ""))
+
+
+def budget(night_h: float, ap_min: float, i_base: float, i_ap: float, i_ble: float):
+    """Charge per night: AP all night vs. BLE with the AP on demand. / Ladung je Nacht."""
+    ap_only = (i_base + i_ap) * night_h
+    ble = (i_base + i_ble) * night_h + i_ap * ap_min / 60.0
+    print(f"Nacht {night_h:.1f} h, AP auf Abruf {ap_min:.0f} min (Annahmen: Basis {i_base} mA, AP +{i_ap} mA, BLE +{i_ble} mA)")
+    print(f"  nur AP:            {ap_only:7.0f} mAh  (Mittel {ap_only / night_h:5.1f} mA)")
+    print(f"  BLE + AP auf Abruf:{ble:7.0f} mAh  (Mittel {ble / night_h:5.1f} mA)")
+    print(f"  Ersparnis:         {ap_only - ble:7.0f} mAh  ({100 * (ap_only - ble) / ap_only:.0f} %)")
+
+
+async def ble_session(name: str, command: str = None):
+    try:
+        from bleak import BleakClient, BleakScanner
+    except ImportError:
+        print("[FEHLER] Für watch/ap bitte `pip install bleak` installieren.")
+        sys.exit(2)
+    dev = await BleakScanner.find_device_by_filter(
+        lambda d, ad: SERVICE_UUID in ad.service_uuids and (not name or (d.name or "").startswith(name)), timeout=15)
+    if not dev:
+        print("[FEHLER] Keine NEXUS-Station in Reichweite.")
+        sys.exit(1)
+    async with BleakClient(dev) as client:
+        print(f"Verbunden mit {dev.name} ({dev.address})")
+        if command:
+            # Steuerkanal nur nach Koppeln mit dem Passkey (SECRET_BLE_PIN); macOS fragt beim Schreiben selbst nach
+            try:
+                await client.pair()
+            except NotImplementedError:
+                pass
+            await client.write_gatt_char(CONTROL_UUID, encode_command(command), response=True)
+            await asyncio.sleep(1.0)
+            print(show(decode_status(bytes(await client.read_gatt_char(STATUS_UUID)))))
+            return
+        await client.start_notify(STATUS_UUID, lambda _, data: print(show(decode_status(bytes(data)))))
+        try:
+            await client.write_gatt_char(CONTROL_UUID, encode_command("refresh"), response=True)
+        except Exception:
+            pass   # nicht gekoppelt: die Station schickt den Status beim Verbinden ohnehin
+        while client.is_connected:
+            await asyncio.sleep(1.0)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS BLE status / BLE-Status der Station")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    d = sub.add_parser("decode", help="Decode a hex status value / Hex-Status dekodieren")
+    d.add_argument("hex")
+    d.add_argument("--json", action="store_true")
+    l = sub.add_parser("link", help="Read /link and decode its ble_status / /link lesen und dekodieren")
+    l.add_argument("--host", default="192.168.4.1")
+    w = sub.add_parser("watch", help="Show notifications (bleak) / Notifications anzeigen")
+    w.add_argument("--name", default="NEXUS-")
+    a = sub.add_parser("ap", help="Access point on/off over BLE (bleak) / AP per BLE schalten")
+    a.add_argument("state", choices=["on", "off"])
+    a.add_argument("--name", default="NEXUS-")
+    b = sub.add_parser("budget", help="Charge per night, AP vs. BLE / Ladung je Nacht, AP gegen BLE")
+    b.add_argument("--night-h", type=float, default=10.0)
+    b.add_argument("--ap-min", type=float, default=15.0, help="AP on demand per night / AP auf Abruf je Nacht")
+    b.add_argument("--i-base", type=float, default=I_BASE_MA)
+    b.add_argument("--i-ap", type=float, default=I_AP_MA)
+    b.add_argument("--i-ble", type=float, default=I_BLE_MA)
+    args = ap.parse_args()
+
+    try:
+        if args.cmd == "decode":
+            s = decode_status(bytes.fromhex(args.hex.replace(" ", "").replace("-", "")))
+            print(json.dumps(s, indent=1) if args.json else show(s))
+        elif args.cmd == "link":
+            base = args.host if args.host.startswith("http") else f"http://{args.host}"
+            with urllib.request.urlopen(base + "/link", timeout=5) as resp:
+                info = json.loads(resp.read())
+            print(show(decode_status(bytes.fromhex(info["ble_status"]))))
+            if "ap_on_s" in info and info.get("uptime_s"):
+                print(f"AP lief {info['ap_on_s'] / 3600:.1f} von {info['uptime_s'] / 3600:.1f} h "
+                      f"({100 * info['ap_on_s'] / info['uptime_s']:.0f} %), BLE-Clients {info.get('ble_clients', '-')}, "
+                      f"Notifications {info.get('ble_notifies', '-')}")
+        elif args.cmd == "watch":
+            asyncio.run(ble_session(args.name))
+        elif args.cmd == "ap":
+            asyncio.run(ble_session(args.name, "ap_on" if args.state == "on" else "ap_off"))
+        else:
+            budget(args.night_h, args.ap_min, args.i_base, args.i_ap, args.i_ble)
+    except ValueError as e:
+        print(f"[FEHLER] {e}")
+        sys.exit(2)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
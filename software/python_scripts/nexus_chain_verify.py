@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - Log Chain Verifier
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: Verifies the SHA-256 hash chain (<session>.chain) and the signed
+         chain head (<session>.sig) of every binary session log (.bin) in
+         the given folders - a whole season of SD card copies in parallel.
+         / Prüft die SHA-256-Hashkette (<session>.chain) und den signierten
+         Kettenkopf (<session>.sig) aller binären Session-Logs (.bin) in den
+         angegebenen Ordnern - eine ganze Saison SD-Kopien parallel.
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import struct
+import sys
+from concurrent.futures import ProcessPoolExecutor
+from pathlib import Path
+
+# --- Binary formats (must match main.cpp) / Binärformate (wie in main.cpp) ---
+LOGBIN_HEADER = struct.Struct("<4sBBxxII")           # "NXLB", version, rec size, session id, station id
+CHAIN_ENTRY = struct.Struct("<IHH32s")               # first record index in .bin (not LogRecord.seq), count, reserved, hash
+CHAIN_SIG = struct.Struct("<4sBBxxIII32s32s")        # "NXSG", version, keyed, session, station, records, head, hmac
+SIG_SIGNED_LEN = CHAIN_SIG.size - 32                 # HMAC über alles vor dem HMAC-Feld
+
+
+def verify_session(bin_path: str, key: bytes) -> dict:
+    """
+    Recomputes the chain of one session. Status: OK (signed and verified),
+    UNSIGNED (chain intact, no/unkeyed signature), OPEN (records after the
+    last block not yet covered, e.g. power loss), FAIL (tampered/corrupt).
+    / Berechnet die Kette einer Session neu.
+    """
+    res = {"file": bin_path, "status": "FAIL", "records": 0, "covered": 0, "msg": ""}
+    data = Path(bin_path).read_bytes()
+    if len(data) < LOGBIN_HEADER.size:
+        res["msg"] = "short header"
+        return res
+    magic, _, rec_size, session, station = LOGBIN_HEADER.unpack_from(data)
+    if magic != b"NXLB" or rec_size == 0:
+        res["msg"] = f"not a NEXUS log ({magic!r})"
+        return res
+    n_rec = (len(data) - LOGBIN_HEADER.size) // rec_size
+    res["records"] = n_rec
+    head = hashlib.sha256(data[:LOGBIN_HEADER.size]).digest()
+
+    chain_path = Path(bin_path).with_suffix(".chain")
+    raw = chain_path.read_bytes() if chain_path.exists() else b""
+    if len(raw) % CHAIN_ENTRY.size:
+        res["msg"] = f".chain has a partial entry ({len(raw)} bytes)"
+        return res
+    seq = 0
+    for b in range(len(raw) // CHAIN_ENTRY.size):
+        first, count, _, h = CHAIN_ENTRY.unpack_from(raw, b * CHAIN_ENTRY.size)
+        if first != seq or count == 0 or first + count > n_rec:
+            res["msg"] = f"block {b}: covers {first}+{count}, expected start {seq} of {n_rec}"
+            return res
+        start = LOGBIN_HEADER.size + first * rec_size
+        head = hashlib.sha256(head + data[start:start + count * rec_size]).digest()
+        if head != h:
+            res["msg"] = f"block {b}: hash mismatch in records {first}..{first + count - 1}"
+            return res
+        seq += count
+    res["covered"] = seq
+    res["head"] = head.hex()
+
+    sig_path = Path(bin_path).with_suffix(".sig")
+    if not sig_path.exists():
+        res["status"] = "OPEN" if seq < n_rec else "UNSIGNED"
+        res["msg"] = f"{n_rec - seq} record(s) after last block" if seq < n_rec else "no .sig (session not ended)"
+        return res
+    sig = sig_path.read_bytes()
+    if len(sig) != CHAIN_SIG.size:
+        res["msg"] = ".sig has wrong size"
+        return res
+    magic, _, keyed, s_session, s_station, s_records, s_head, s_mac = CHAIN_SIG.unpack(sig)
+    if magic != b"NXSG" or (s_session, s_station) != (session, station):
+        res["msg"] = ".sig belongs to another session/station"
+        return res
+    if s_records != seq or s_head != head:
+        res["msg"] = f".sig head/record count ({s_records}) does not match chain ({seq})"
+        return res
+    if seq < n_rec:
+        res["msg"] = f"{n_rec - seq} record(s) appended after the seal"
+        return res
+    if not keyed:
+        res["status"], res["msg"] = "UNSIGNED", "station has no SECRET_LOG_KEY"
+        return res
+    if not key:
+        res["status"], res["msg"] = "UNSIGNED", "signed, but no --key given"
+        return res
+    if not hmac.compare_digest(hmac.new(key, sig[:SIG_SIGNED_LEN], hashlib.sha256).digest(), s_mac):
+        res["msg"] = "HMAC mismatch (wrong key or forged .sig)"
+        return res
+    res["status"] = "OK"
+    return res
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS hash chain verifier / Prüfung der Log-Hashketten")
+    ap.add_argument("paths", nargs="+", type=Path, help="Folders or .bin files / Ordner oder .bin-Dateien")
+    ap.add_argument("--key", default=os.environ.get("NEXUS_LOG_KEY", ""), help="SECRET_LOG_KEY of the station (or env NEXUS_LOG_KEY)")
+    ap.add_argument("--jobs", type=int, default=os.cpu_count(), help="Parallel workers / Parallele Prozesse")
+    args = ap.parse_args()
+
+    files = []
+    for p in args.paths:
+        files += [str(f) for f in sorted(p.rglob("*.bin"))] if p.is_dir() else [str(p)]
+    if not files:
+        print("[FEHLER] Keine .bin-Dateien gefunden.")
+        sys.exit(2)
+
+    key = args.key.encode()
+    counts = {}
+    with ProcessPoolExecutor(max_workers=args.jobs) as pool:
+        for r in pool.map(verify_session, files, [key] * len(files), chunksize=4):
+            counts[r["status"]] = counts.get(r["status"], 0) + 1
+            print(f"[{r['status']:8}] {r['file']}: {r['covered']}/{r['records']} Datensätze"
+                  + (f" - {r['msg']}" if r["msg"] else "") + (f" (Kopf {r['head'][:16]})" if "head" in r else ""))
+    print("Ergebnis: " + ", ".join(f"{k}: {v}" for k, v in sorted(counts.items())))
+    sys.exit(1 if counts.get("FAIL") else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,402 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - Fleet Collector
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: One laptop collects from all stations of a survey at once: live
+         snapshots (/data) and log batches (/sync) are pulled from every
+         station concurrently (asyncio, one core), de-duplicated by
+         station, session and sequence number and written to a store
+         partitioned per station and UTC day. A small HTTP API answers
+         queries (stations, latest snapshots, records by time range as
+         CSV or JSON). `simulate` starts dozens of simulated stations for
+         load tests.
+         / Ein Laptop sammelt von allen Stationen einer Erfassung
+         gleichzeitig: Schnappschüsse (/data) und Log-Pakete (/sync)
+         werden parallel abgeholt (asyncio, ein Kern), nach Station,
+         Session und Sequenznummer entdoppelt und in einen Speicher je
+         Station und UTC-Tag geschrieben. Eine kleine HTTP-API beantwortet
+         Abfragen (Stationen, letzte Schnappschüsse, Datensätze nach
+         Zeitraum als CSV oder JSON). `simulate` startet dutzende
+         simulierte Stationen für Lasttests.
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import asyncio
+import binascii
+import datetime
+import http.server
+import json
+import os
+import random
+import struct
+import threading
+import time
+import urllib.parse
+from pathlib import Path
+
+from nexus_sync_client import BATCH_HEADER, BATCH_SIZE, CSV_HEADER, RECORD, BatchError, decode_record, parse_batch, record_to_csv
+
+# **********************************************************
+# * CONFIGURATION / KONFIGURATION
+# **********************************************************
+DEFAULT_STORE = Path(__file__).resolve().parent / "nexus_fleet"
+DEFAULT_API = "127.0.0.1:8090"
+POLL_S = 10.0                          # Abfrageintervall je Station
+TIMEOUT_S = 10.0
+BACKOFF_MAX_S = 120.0
+
+# --- Store format / Speicherformat ---
+# <store>/<station>/<YYYYMMDD>.nxf: Kopf, dann je Eintrag Session-ID + LogRecord
+PART_HEADER = struct.Struct("<4sBBxxII")                 # "NXFD", version, entry size, station id, day (YYYYMMDD)
+ENTRY = struct.Struct(f"<I{RECORD.size}s")               # session id, LogRecord
+
+
+# **********************************************************
+# * STORE / SPEICHER
+# **********************************************************
+class Store:
+    """
+    Per station: day partitions plus cursor.json (session -> next seq).
+    The cursor is replaced atomically after the data is flushed; a crash
+    in between can leave duplicates, which queries drop.
+    / Je Station: Tagespartitionen plus cursor.json (Session -> nächste Seq).
+    """
+
+    def __init__(self, root: Path):
+        self.root = root
+        self.cursors = {}
+        self.lock = threading.Lock()                     # API-Thread liest, asyncio-Schleife schreibt
+
+    def station_dir(self, station: int) -> Path:
+        d = self.root / f"{station:08x}"
+        d.mkdir(parents=True, exist_ok=True)
+        return d
+
+    def cursor(self, station: int, session: int) -> int:
+        if station not in self.cursors:
+            p = self.station_dir(station) / "cursor.json"
+            self.cursors[station] = {int(k): v for k, v in json.loads(p.read_text()).items()} if p.exists() else {}
+        return self.cursors[station].get(session, 0)
+
+    def append(self, station: int, session: int, first: int, recs: bytes) -> int:
+        """Writes the records from the cursor on; returns the number of new ones. / Schreibt ab dem Cursor."""
+        cur = self.cursor(station, session)
+        n = len(recs) // RECORD.size
+        if first > cur:
+            raise BatchError(f"gap: batch starts at {first}, cursor {cur}")
+        skip = cur - first
+        if skip >= n:
+            return 0
+        parts = {}
+        for i in range(skip, n):
+            raw = recs[i * RECORD.size:(i + 1) * RECORD.size]
+            unix = RECORD.unpack_from(raw)[1]
+            day = int(datetime.datetime.fromtimestamp(unix, datetime.timezone.utc).strftime("%Y%m%d"))
+            parts.setdefault(day, []).append(ENTRY.pack(session, raw))
+        d = self.station_dir(station)
+        with self.lock:
+            for day, entries in parts.items():
+                p = d / f"{day}.nxf"
+                new = not p.exists()
+                with open(p, "ab") as fh:
+                    if new:
+                        fh.write(PART_HEADER.pack(b"NXFD", 1, ENTRY.size, station, day))
+                    fh.write(b"".join(entries))
+                    fh.flush()
+                    os.fsync(fh.fileno())
+            self.cursors[station][session] = first + n
+            tmp = d / "cursor.json.tmp"
+            tmp.write_text(json.dumps(self.cursors[station]))
+            os.replace(tmp, d / "cursor.json")
+        return n - skip
+
+    def save_snapshot(self, station: int, body: bytes):
+        d = self.station_dir(station)
+        (d / "latest.json.tmp").write_bytes(body)
+        os.replace(d / "latest.json.tmp", d / "latest.json")
+
+    def stations(self) -> list:
+        return sorted(int(p.name, 16) for p in self.root.iterdir() if p.is_dir() and len(p.name) == 8) if self.root.exists() else []
+
+    def query(self, station: int, t_from: float, t_to: float) -> list:
+        """Decoded records in [t_from, t_to), time-sorted, duplicates dropped. / Datensätze im Zeitraum."""
+        d = self.root / f"{station:08x}"
+        day0 = int(datetime.datetime.fromtimestamp(max(t_from, 0), datetime.timezone.utc).strftime("%Y%m%d"))
+        day1 = int(datetime.datetime.fromtimestamp(min(t_to, 4e9), datetime.timezone.utc).strftime("%Y%m%d"))
+        seen, out = set(), []
+        with self.lock:
+            files = sorted(p for p in d.glob("*.nxf") if day0 <= int(p.stem) <= day1) if d.exists() else []
+            blobs = [p.read_bytes() for p in files]
+        for data in blobs:
+            end = PART_HEADER.size + (len(data) - PART_HEADER.size) // ENTRY.size * ENTRY.size   # halben Eintrag ignorieren
+            for session, raw in ENTRY.iter_unpack(data[PART_HEADER.size:end]):
+                r = decode_record(raw)
+                key = (session, r["Seq"])
+                if key in seen or not t_from <= r["Unix"] < t_to:
+                    continue
+                seen.add(key)
+                r["Session"] = session
+                out.append(r)
+        out.sort(key=lambda r: r["Unix"])
+        return out
+
+
+# **********************************************************
+# * COLLECTOR / SAMMLER
+# **********************************************************
+async def http_get(host: str, path: str) -> tuple:
+    """Minimal HTTP/1.0 GET on asyncio streams. / Minimales HTTP/1.0-GET."""
+    h, _, port = host.partition(":")
+    reader, writer = await asyncio.wait_for(asyncio.open_connection(h, int(port or 80)), TIMEOUT_S)
+    try:
+        writer.write(f"GET {path} HTTP/1.0\r\nHost: {h}\r\nConnection: close\r\n\r\n".encode())
+        raw = await asyncio.wait_for(reader.read(), TIMEOUT_S)
+    finally:
+        writer.close()
+    head, _, body = raw.partition(b"\r\n\r\n")
+    lines = head.decode("latin-1").split("\r\n")
+    hdrs = {k.strip().lower(): v.strip() for k, _, v in (l.partition(":") for l in lines[1:])}
+    if not lines[0].startswith("HTTP/") or ("content-length" in hdrs and int(hdrs["content-length"]) != len(body)):
+        raise ConnectionError(f"{path}: truncated response")           # Funkabbruch mitten in der Antwort
+    return int(lines[0].split()[1]), body
+
+
+class StationWorker:
+    def __init__(self, host: str, store: Store, poll_s: float):
+        self.host, self.store, self.poll_s = host, store, poll_s
+        self.station = None
+        self.stats = {"host": host, "station": None, "records": 0, "batches": 0, "dups": 0, "errors": 0,
+                      "snapshots": 0, "last_ok": None, "lag": None, "last_error": ""}
+
+    async def sync_once(self):
+        status, body = await http_get(self.host, "/data")
+        if status == 200 and self.station is not None:
+            json.loads(body)                                    # nur gültige Schnappschüsse übernehmen
+            self.store.save_snapshot(self.station, body)
+            self.stats["snapshots"] += 1
+        status, body = await http_get(self.host, "/sync/sessions")
+        if status != 200:
+            raise ConnectionError(f"/sync/sessions: HTTP {status}")
+        info = json.loads(body)
+        self.station = self.stats["station"] = info["station"]
+        lag = 0
+        for s in info["sessions"]:
+            if s.get("rec_size", RECORD.size) != RECORD.size:
+                continue
+            cur = self.store.cursor(self.station, s["id"])
+            while cur < s["records"]:
+                status, body = await http_get(self.host, f"/sync?session={s['id']}&seq={cur}&max={BATCH_SIZE}")
+                if status != 200:
+                    raise ConnectionError(f"/sync: HTTP {status}")
+                hdr, recs = parse_batch(body)
+                if hdr["station"] != self.station or hdr["session"] != s["id"] or hdr["count"] == 0:
+                    break
+                new = self.store.append(self.station, s["id"], hdr["first"], recs)
+                self.stats["batches"] += 1
+                self.stats["records"] += new
+                self.stats["dups"] += hdr["count"] - new
+                cur = self.store.cursor(self.station, s["id"])
+                await asyncio.sleep(0)                          # anderen Stationen Vortritt lassen
+            lag += max(0, s["records"] - cur)
+        self.stats["lag"] = lag
+
+    async def run(self):
+        backoff = self.poll_s
+        await asyncio.sleep(random.uniform(0, self.poll_s))     # Stationen zeitlich verteilen
+        while True:
+            try:
+                await self.sync_once()
+                self.stats["last_ok"] = time.time()
+                backoff = self.poll_s
+            except (OSError, asyncio.TimeoutError, ConnectionError, BatchError, ValueError, KeyError) as e:
+                self.stats["errors"] += 1
+                self.stats["last_error"] = str(e) or type(e).__name__
+                backoff = min(backoff * 2, BACKOFF_MAX_S)
+            await asyncio.sleep(backoff)
+
+
+def make_api(store: Store, workers: list):
+    class Api(http.server.BaseHTTPRequestHandler):
+        def send(self, code: int, ctype: str, body: bytes):
+            self.send_response(code)
+            self.send_header("Content-Type", ctype)
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def do_GET(self):
+            u = urllib.parse.urlparse(self.path)
+            q = dict(urllib.parse.parse_qsl(u.query))
+            if u.path == "/stations":
+                self.send(200, "application/json", json.dumps([w.stats for w in workers]).encode())
+            elif u.path == "/latest":
+                out = {}
+                for st in store.stations():
+                    p = store.root / f"{st:08x}" / "latest.json"
+                    if p.exists():
+                        out[f"{st:08x}"] = json.loads(p.read_bytes())
+                self.send(200, "application/json", json.dumps(out).encode())
+            elif u.path == "/records":
+                try:
+                    st = int(q["station"], 16)
+                    t0 = float(q.get("from", 0))
+                    t1 = float(q.get("to", 4e9))
+                except (KeyError, ValueError):
+                    self.send(400, "text/plain", b"station=<hex>&from=<unix>&to=<unix>[&fmt=csv|json]")
+                    return
+                recs = store.query(st, t0, t1)
+                if q.get("fmt") == "json":
+                    self.send(200, "application/json", json.dumps(recs).encode())
+                else:
+                    lines = ["Session," + CSV_HEADER]
+                    lines += [f"{r['Session']},{record_to_csv(r)}" for r in recs]
+                    self.send(200, "text/csv", ("\n".join(lines) + "\n").encode())
+            else:
+                self.send(404, "text/plain", b"/stations, /latest, /records?station=&from=&to=&fmt=")
+
+        def log_message(self, fmt, *args):
+            pass
+    return Api
+
+
+def parse_hosts(specs: list) -> list:
+    """host[:port], host:9000-9039 (port range) or @file. / Host-Liste."""
+    hosts = []
+    for s in specs:
+        if s.startswith("@"):
+            hosts += parse_hosts([l.strip() for l in Path(s[1:]).read_text().splitlines() if l.strip() and not l.startswith("#")])
+            continue
+        h, _, ports = s.partition(":")
+        if "-" in ports:
+            a, b = map(int, ports.split("-"))
+            hosts += [f"{h}:{p}" for p in range(a, b + 1)]
+        else:
+            hosts.append(s)
+    return hosts
+
+
+async def collect(hosts: list, store: Store, api: str, poll_s: float):
+    workers = [StationWorker(h, store, poll_s) for h in hosts]
+    host, _, port = api.rpartition(":")
+    srv = http.server.ThreadingHTTPServer((host, int(port)), make_api(store, workers))
+    threading.Thread(target=srv.serve_forever, daemon=True).start()
+    print(f"{len(workers)} Station(en), Speicher {store.root}, API http://{api}/stations")
+    tasks = [asyncio.ensure_future(w.run()) for w in workers]
+    cpu0, t0, last = time.process_time(), time.time(), 0
+    try:
+        while True:
+            await asyncio.sleep(30)
+            total = sum(w.stats["records"] for w in workers)
+            cpu, wall = time.process_time() - cpu0, time.time() - t0
+            ok = sum(1 for w in workers if w.stats["last_ok"] and time.time() - w.stats["last_ok"] < 3 * poll_s + 30)
+            print(f"{ok}/{len(workers)} Stationen aktuell, {total} Datensätze (+{total - last}), "
+                  f"Rückstand {sum(w.stats['lag'] or 0 for w in workers)}, CPU {100 * cpu / wall:.1f} % eines Kerns")
+            last = total
+    finally:
+        for t in tasks:
+            t.cancel()
+
+
+# **********************************************************
+# * SIMULATED STATIONS / SIMULIERTE STATIONEN
+# **********************************************************
+class SimStation:
+    """Serves /data, /sync/sessions and /sync like the firmware. / Liefert wie die Firmware."""
+
+    def __init__(self, station: int, speed: float, backlog: int):
+        self.station, self.speed = station, speed
+        self.session = int(time.time()) - backlog * 8
+        self.t0 = time.time() - backlog * 8 / speed
+        self.seed = random.Random(station)
+
+    def count(self) -> int:
+        return int((time.time() - self.t0) * self.speed / 8)
+
+    def record(self, seq: int) -> bytes:
+        rnd = random.Random(self.station * 1000003 + seq)
+        return RECORD.pack(seq, self.session + 8 * seq, 1500 + rnd.randint(-200, 200), 7000, 10130, rnd.randint(0, 600),
+                           rnd.randint(300, 900), rnd.randint(0, 359), 0, 480000000 + (self.station & 0xFFFF) * 1000, 90000000, 7, 3, 9, 0,
+                           0, 800, 0, 0)
+
+    def handle(self, path: str) -> tuple:
+        u = urllib.parse.urlparse(path)
+        q = dict(urllib.parse.parse_qsl(u.query))
+        if u.path == "/data":
+            return 200, json.dumps({"station": f"{self.station:08x}", "temp": 15.0, "w_avg": 2.1}).encode()
+        if u.path == "/sync/sessions":
+            return 200, json.dumps({"station": self.station, "current": self.session, "rec_size": RECORD.size,
+                                    "sessions": [{"id": self.session, "records": self.count(), "rec_size": RECORD.size}]}).encode()
+        if u.path == "/sync":
+            seq, total = int(q.get("seq", 0)), self.count()
+            n = max(0, min(total - seq, int(q.get("max", BATCH_SIZE)), BATCH_SIZE))
+            body = BATCH_HEADER.pack(b"NXSB", 2, RECORD.size, n, self.station, self.session, seq, total)
+            body += b"".join(self.record(i) for i in range(seq, seq + n))
+            return 200, body + struct.pack("<I", binascii.crc32(body))
+        return 404, b"not found"
+
+
+async def simulate(count: int, base_port: int, speed: float, backlog: int, fail: float):
+    async def serve(sim: SimStation, reader, writer):
+        try:
+            line = (await reader.readline()).decode()
+            while (await reader.readline()) not in (b"\r\n", b"\n", b""):
+                pass
+            code, body = sim.handle(line.split(" ")[1])
+            cut = len(body) // 2 if random.random() < fail else len(body)   # Funkabbruch mitten in der Antwort
+            writer.write(f"HTTP/1.0 {code} OK\r\nContent-Length: {len(body)}\r\n\r\n".encode() + body[:cut])
+            await writer.drain()
+        except (OSError, IndexError):
+            pass
+        finally:
+            writer.close()
+    servers = []
+    for i in range(count):
+        sim = SimStation(0x5E000000 + i, speed, backlog)
+        servers.append(await asyncio.start_server(lambda r, w, s=sim: serve(s, r, w), "127.0.0.1", base_port + i))
+    print(f"{count} simulierte Stationen auf 127.0.0.1:{base_port}-{base_port + count - 1} "
+          f"(Zeitraffer x{speed}, Rückstand {backlog} Datensätze, Abbruchrate {fail:.0%})")
+    await asyncio.gather(*(s.serve_forever() for s in servers))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS fleet collector / Sammelstelle für mehrere Stationen")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    c = sub.add_parser("collect", help="Pull from all stations / Von allen Stationen abholen")
+    c.add_argument("stations", nargs="+", help="host[:port], host:9000-9039 or @file")
+    c.add_argument("--store", type=Path, default=DEFAULT_STORE)
+    c.add_argument("--api", default=DEFAULT_API)
+    c.add_argument("--poll", type=float, default=POLL_S)
+    s = sub.add_parser("simulate", help="Simulated stations / Simulierte Stationen")
+    s.add_argument("--count", type=int, default=40)
+    s.add_argument("--base-port", type=int, default=9000)
+    s.add_argument("--speed", type=float, default=1.0, help="Time lapse / Zeitraffer")
+    s.add_argument("--backlog", type=int, default=2000, help="Records already logged / Bereits geloggte Datensätze")
+    s.add_argument("--fail", type=float, default=0.02, help="Share of broken responses / Anteil abgebrochener Antworten")
+    args = ap.parse_args()
+    try:
+        if args.cmd == "collect":
+            asyncio.run(collect(parse_hosts(args.stations), Store(args.store), args.api, args.poll))
+        else:
+            asyncio.run(simulate(args.count, args.base_port, args.speed, args.backlog, args.fail))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
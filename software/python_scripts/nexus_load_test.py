@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - Web Load Test
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: Simulates several phones polling /data like the web interface does
+         and reports latency, 304 share and the station's cache counters
+         (/perf) - i.e. how many serializations N clients really cost.
+         / Simuliert mehrere Handys, die /data wie das Web-Interface abfragen,
+         und meldet Latenz, 304-Anteil und die Cache-Zähler der Station
+         (/perf) - also wie viele Serialisierungen N Clients wirklich kosten.
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import json
+import statistics
+import threading
+import time
+import urllib.error
+import urllib.request
+
+# **********************************************************
+# * CONFIGURATION / KONFIGURATION
+# **********************************************************
+DEFAULT_HOST = "192.168.4.1"          # NEXUS Access Point
+DEFAULT_CLIENTS = 5
+DEFAULT_INTERVAL_S = 2.0              # Wie setInterval(u,2000) im Web-Interface
+DEFAULT_DURATION_S = 80.0             # 10 Messzyklen à 8 s
+TIMEOUT_S = 5
+
+
+class Client(threading.Thread):
+    """
+    One polling client. With etag=True it sends If-None-Match like a browser
+    with a warm cache. / Ein abfragender Client, optional mit If-None-Match.
+    """
+
+    def __init__(self, base: str, interval: float, until: float, etag: bool):
+        super().__init__(daemon=True)
+        self.base, self.interval, self.until, self.use_etag = base, interval, until, etag
+        self.latencies, self.status = [], {}
+        self.bytes_rx, self.errors = 0, 0
+        self.etag = None
+
+    def run(self):
+        while time.time() < self.until:
+            start = time.time()
+            req = urllib.request.Request(self.base + "/data")
+            if self.use_etag and self.etag:
+                req.add_header("If-None-Match", self.etag)
+            try:
+                with urllib.request.urlopen(req, timeout=TIMEOUT_S) as resp:
+                    body = resp.read()
+                    code = resp.status
+                    self.etag = resp.headers.get("ETag", self.etag)
+            except urllib.error.HTTPError as e:   # 304 kommt bei urllib als HTTPError
+                body, code = b"", e.code
+            except (urllib.error.URLError, OSError):
+                self.errors += 1
+                time.sleep(self.interval)
+                continue
+            self.latencies.append((time.time() - start) * 1000.0)
+            self.status[code] = self.status.get(code, 0) + 1
+            self.bytes_rx += len(body)
+            time.sleep(max(0.0, self.interval - (time.time() - start)))
+
+
+def get_perf(base: str) -> dict:
+    with urllib.request.urlopen(base + "/perf", timeout=TIMEOUT_S) as resp:
+        return json.loads(resp.read())
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS /data load test / Lasttest für /data")
+    ap.add_argument("--host", default=DEFAULT_HOST)
+    ap.add_argument("--clients", type=int, default=DEFAULT_CLIENTS)
+    ap.add_argument("--interval", type=float, default=DEFAULT_INTERVAL_S)
+    ap.add_argument("--duration", type=float, default=DEFAULT_DURATION_S)
+    ap.add_argument("--etag", action="store_true", help="Send If-None-Match / Mit If-None-Match abfragen")
+    args = ap.parse_args()
+    base = args.host if args.host.startswith("http") else f"http://{args.host}"
+
+    before = get_perf(base)
+    until = time.time() + args.duration
+    clients = [Client(base, args.interval, until, args.etag) for _ in range(args.clients)]
+    for c in clients:
+        c.start()
+        time.sleep(args.interval / len(clients))   # Clients versetzt starten wie echte Handys
+    for c in clients:
+        c.join()
+    after = get_perf(base)
+
+    lat = [x for c in clients for x in c.latencies]
+    status = {}
+    for c in clients:
+        for k, v in c.status.items():
+            status[k] = status.get(k, 0) + v
+    requests = sum(status.values())
+    misses = after["data_misses"] - before["data_misses"]
+    hits = after["data_hits"] - before["data_hits"]
+    cycles = max(after["pub"] - before["pub"], 1)   # Veröffentlichungen (Messungen bzw. 2-s-Takt ohne Session)
+
+    print(f"Clients: {args.clients}, Intervall {args.interval:.1f} s, Dauer {args.duration:.0f} s, ETag: {'ja' if args.etag else 'nein'}")
+    print(f"Anfragen:  {requests} ({', '.join(f'{k}: {v}' for k, v in sorted(status.items()))}), Fehler: {sum(c.errors for c in clients)}")
+    if lat:
+        lat.sort()
+        print(f"Latenz:    median {statistics.median(lat):.0f} ms, p95 {lat[int(0.95 * (len(lat) - 1))]:.0f} ms, max {lat[-1]:.0f} ms")
+    print(f"Empfangen: {sum(c.bytes_rx for c in clients) / 1024:.1f} KB")
+    print(f"Cache:     {misses} Serialisierungen, {hits} Treffer ({100.0 * hits / max(hits + misses, 1):.0f} %), "
+          f"{after['data_304'] - before['data_304']} x 304")
+    print(f"Pro Snapshot: {requests / cycles:.1f} Anfragen -> {misses / cycles:.2f} Serialisierungen "
+          f"(ohne Cache: {requests / cycles:.1f})")
+    print(f"CPU/Zyklus: idle {after['idle_avg_us']} us, beobachtet {after['observed_avg_us']} us")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,307 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - MQTT Collector
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: Receives what stations publish over MQTT: record batches
+         (nexus/<station>/records, /sync format, QoS 1) are checked by
+         CRC, de-duplicated by cursor and appended to the same mirror as
+         nexus_sync_client.py; snapshots (nexus/<station>/data) are kept
+         as latest JSON. `broker` is a stand-in for mosquitto (no other
+         clients needed) that can drop connections, delay or lose PUBACKs
+         and go offline to exercise the station's offline queue;
+         `subscribe` attaches to a real broker. Prints throughput and,
+         with --station, the station's radio/energy figures (/mqtt).
+         / Nimmt auf, was Stationen per MQTT veröffentlichen: Datensatz-
+         Pakete (nexus/<station>/records, /sync-Format, QoS 1) werden per
+         CRC geprüft, per Cursor entdoppelt und an denselben Spiegel wie
+         bei nexus_sync_client.py angehängt; Schnappschüsse
+         (nexus/<station>/data) als letzter Stand gespeichert. `broker`
+         ersetzt mosquitto (keine weiteren Clients nötig) und kann
+         Verbindungen trennen, PUBACKs verzögern oder verlieren und
+         offline gehen, um die Offline-Warteschlange der Station zu prüfen;
+         `subscribe` hängt sich an einen echten Broker. Zeigt Durchsatz
+         und mit --station die Funk-/Energiekennzahlen der Station (/mqtt).
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import json
+import random
+import socket
+import socketserver
+import struct
+import sys
+import threading
+import time
+import urllib.request
+from pathlib import Path
+
+from nexus_sync_client import (BatchError, CSV_HEADER, LOGBIN_HEADER, LOGBIN_VERSION, RECORD, DEFAULT_MIRROR,
+                               SyncClient, decode_record, parse_batch, record_to_csv)
+
+# **********************************************************
+# * CONFIGURATION / KONFIGURATION
+# **********************************************************
+DEFAULT_LISTEN = "0.0.0.0:1883"
+I_STA_MA = 25.0                       # zusätzlicher Strom im Stationsmodus (Modem-Sleep), am Aufbau nachmessen
+REPORT_S = 30
+
+
+def read_packet(sock: socket.socket) -> tuple:
+    """One MQTT packet: (type, flags, body). / Ein MQTT-Paket."""
+    def exact(n):
+        buf = b""
+        while len(buf) < n:
+            chunk = sock.recv(n - len(buf))
+            if not chunk:
+                raise ConnectionError("closed")
+            buf += chunk
+        return buf
+    h = exact(1)[0]
+    length, shift = 0, 0
+    while True:
+        b = exact(1)[0]
+        length |= (b & 127) << shift
+        shift += 7
+        if not b & 128:
+            break
+    return h >> 4, h & 15, exact(length)
+
+
+def packet(ptype: int, flags: int, body: bytes) -> bytes:
+    n, rl = len(body), bytearray()
+    while True:
+        b, n = n & 127, n >> 7
+        rl.append(b | (128 if n else 0))
+        if not n:
+            return bytes([ptype << 4 | flags]) + bytes(rl) + body
+
+
+def mqtt_str(s: str) -> bytes:
+    return struct.pack(">H", len(s)) + s.encode()
+
+
+class Collector:
+    """Mirror writer and counters, shared by broker and subscriber. / Spiegel und Zähler."""
+
+    def __init__(self, mirror: Path):
+        self.sync = SyncClient("localhost", mirror)           # nur für Pfade und lokalen Cursor
+        self.mirror = mirror
+        self.lock = threading.Lock()
+        self.start = time.time()
+        self.stats = {"msgs": 0, "records": 0, "bytes": 0, "dups": 0, "gaps": 0, "bad": 0, "snapshots": 0}
+
+    def on_publish(self, topic: str, payload: bytes):
+        parts = topic.split("/")
+        if len(parts) != 3 or parts[0] != "nexus":
+            return
+        with self.lock:
+            self.stats["bytes"] += len(payload)
+            if parts[2] == "data":
+                self.stats["snapshots"] += 1
+                d = self.mirror / parts[1]
+                d.mkdir(parents=True, exist_ok=True)
+                (d / "latest.json").write_bytes(payload)
+            elif parts[2] == "records":
+                self.stats["msgs"] += 1
+                try:
+                    hdr, recs = parse_batch(payload)
+                except BatchError as e:
+                    self.stats["bad"] += 1
+                    print(f"[WARN] {topic}: Paket verworfen ({e})")
+                    return
+                self.append(hdr, recs)
+
+    def append(self, hdr: dict, recs: bytes):
+        station, session, first, count = hdr["station"], hdr["session"], hdr["first"], hdr["count"]
+        cursor = self.sync.local_cursor(station, session)
+        if first > cursor:                                     # Lücke: Cursor-Datei der Station verloren?
+            self.stats["gaps"] += 1
+            print(f"[WARN] Session {session}: Paket ab {first}, lokal erst {cursor} - mit nexus_sync_client.py nachholen")
+            return
+        skip = cursor - first
+        self.stats["dups"] += min(skip, count)
+        if skip >= count:
+            return
+        bin_path, csv_path = self.sync.session_paths(station, session)
+        new_file = not bin_path.exists()
+        with open(bin_path, "ab") as fb, open(csv_path, "a", encoding="utf-8") as fc:
+            if new_file:
+                fb.write(LOGBIN_HEADER.pack(b"NXLB", LOGBIN_VERSION, RECORD.size, session, station))
+                fc.write(CSV_HEADER + "\n")
+            fb.write(recs[skip * RECORD.size:])
+            for i in range(skip, count):
+                fc.write(record_to_csv(decode_record(recs[i * RECORD.size:(i + 1) * RECORD.size])) + "\n")
+        self.stats["records"] += count - skip
+
+    def report(self) -> str:
+        with self.lock:
+            s = dict(self.stats)
+        dt = max(time.time() - self.start, 1e-6)
+        return (f"{s['msgs']} Pakete, {s['records']} Datensätze ({s['records'] / dt * 60:.1f}/min), {s['snapshots']} Schnappschüsse, "
+                f"{s['bytes'] / 1024:.1f} KB ({s['bytes'] / dt:.0f} B/s), Duplikate {s['dups']}, Lücken {s['gaps']}, defekt {s['bad']}")
+
+
+class Faults:
+    def __init__(self, drop_every: int, ack_delay: float, ack_loss: float, offline: tuple):
+        self.drop_every, self.ack_delay, self.ack_loss = drop_every, ack_delay, ack_loss
+        self.offline_every, self.offline_for = offline
+        self.t0 = time.time()
+
+    def offline(self) -> bool:
+        return bool(self.offline_every) and (time.time() - self.t0) % self.offline_every >= self.offline_every - self.offline_for
+
+
+def make_broker(col: Collector, faults: Faults):
+    class Session(socketserver.BaseRequestHandler):
+        def handle(self):
+            sock = self.request
+            if faults.offline():
+                return
+            try:
+                ptype, _, body = read_packet(sock)
+                if ptype != 1:
+                    return
+                n = struct.unpack_from(">H", body)[0]
+                if body[2:2 + n] != b"MQTT":
+                    return
+                cid_len = struct.unpack_from(">H", body, 10)[0]
+                cid = body[12:12 + cid_len].decode(errors="replace")
+                sock.sendall(packet(2, 0, b"\x00\x00"))
+                print(f"[+] {cid} verbunden ({self.client_address[0]})")
+                publishes = 0
+                while True:
+                    ptype, flags, body = read_packet(sock)
+                    if faults.offline():
+                        print(f"[-] {cid}: Broker offline (Testphase)")
+                        return
+                    if ptype == 3:                              # PUBLISH
+                        tl = struct.unpack_from(">H", body)[0]
+                        topic, off = body[2:2 + tl].decode(), 2 + tl
+                        qos = flags >> 1 & 3
+                        pid = struct.unpack_from(">H", body, off)[0] if qos else 0
+                        col.on_publish(topic, body[off + (2 if qos else 0):])
+                        publishes += 1
+                        if faults.drop_every and publishes % faults.drop_every == 0:
+                            print(f"[-] {cid}: Verbindung absichtlich getrennt")
+                            return
+                        if qos == 1 and random.random() >= faults.ack_loss:
+                            if faults.ack_delay:
+                                time.sleep(faults.ack_delay)
+                            sock.sendall(packet(4, 0, struct.pack(">H", pid)))
+                    elif ptype == 12:                           # PINGREQ
+                        sock.sendall(packet(13, 0, b""))
+                    elif ptype == 14:                           # DISCONNECT
+                        return
+            except (ConnectionError, OSError, struct.error):
+                print("[-] Verbindung beendet")
+    return Session
+
+
+def subscribe(col: Collector, host: str, port: int, stop: threading.Event):
+    """Client against a real broker: nexus/+/# with QoS 1. / Client an einem echten Broker."""
+    while not stop.is_set():
+        try:
+            sock = socket.create_connection((host, port), timeout=90)
+            cid = f"nexus-collector-{random.randrange(1 << 16):04x}"
+            sock.sendall(packet(1, 0, mqtt_str("MQTT") + bytes([4, 0x02]) + struct.pack(">H", 60) + mqtt_str(cid)))
+            read_packet(sock)
+            sock.sendall(packet(8, 2, struct.pack(">H", 1) + mqtt_str("nexus/+/#") + b"\x01"))
+            print(f"Abonniert nexus/+/# auf {host}:{port}")
+            last_ping = time.time()
+            sock.settimeout(30)
+            while not stop.is_set():
+                try:
+                    ptype, flags, body = read_packet(sock)
+                except socket.timeout:
+                    ptype = None
+                if ptype == 3:
+                    tl = struct.unpack_from(">H", body)[0]
+                    qos = flags >> 1 & 3
+                    off = 2 + tl
+                    col.on_publish(body[2:off].decode(), body[off + (2 if qos else 0):])
+                    if qos == 1:
+                        sock.sendall(packet(4, 0, body[off:off + 2]))
+                if time.time() - last_ping > 30:
+                    sock.sendall(packet(12, 0, b""))
+                    last_ping = time.time()
+        except (ConnectionError, OSError, struct.error) as e:
+            print(f"[WARN] Broker {host}:{port}: {e} - neuer Versuch in 5 s")
+            stop.wait(5)
+
+
+def station_report(host: str, i_sta: float):
+    base = host if host.startswith("http") else f"http://{host}"
+    try:
+        with urllib.request.urlopen(base + "/mqtt", timeout=5) as resp:
+            m = json.loads(resp.read())
+    except (OSError, ValueError) as e:
+        print(f"[WARN] /mqtt nicht lesbar ({e})")
+        return
+    per_rec = m["bytes"] / m["records"] if m["records"] else 0
+    mah = i_sta * m["sta_s"] / 3600.0
+    print(f"Station: {m['msgs']} Pakete / {m['records']} Datensätze bestätigt, {per_rec:.0f} B je Datensatz (inkl. Schnappschüsse), "
+          f"PUBACK Mittel {m['ack_ms_avg']} ms / max {m['ack_ms_max']} ms, {m['retries']} Wiederholungen, {m['drops']} Abbrüche")
+    print(f"  Stationsmodus {m['sta_s'] / 3600:.2f} h von {m['uptime_s'] / 3600:.2f} h, MQTT-E/A {m['io_ms']} ms, "
+          f"geschätzt {mah:.0f} mAh zusätzlich (bei +{i_sta} mA), Cursor {m['cursor']['session']}/{m['cursor']['seq']}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS MQTT collector / MQTT-Sammelstelle")
+    ap.add_argument("--mirror", type=Path, default=DEFAULT_MIRROR)
+    ap.add_argument("--station", help="Station address for /mqtt figures / Adresse für /mqtt-Kennzahlen")
+    ap.add_argument("--i-sta", type=float, default=I_STA_MA)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    b = sub.add_parser("broker", help="Stand-in broker / Ersatz-Broker")
+    b.add_argument("--listen", default=DEFAULT_LISTEN)
+    b.add_argument("--drop-every", type=int, default=0, help="Close after N publishes / Nach N Paketen trennen")
+    b.add_argument("--ack-delay", type=float, default=0.0, help="Seconds / Sekunden")
+    b.add_argument("--ack-loss", type=float, default=0.0, help="Share of lost PUBACKs / Anteil verlorener PUBACKs")
+    b.add_argument("--offline", default="0/0", help="EVERY/FOR seconds offline, e.g. 600/120 / alle 600 s für 120 s offline")
+    s = sub.add_parser("subscribe", help="Attach to a real broker / An echten Broker hängen")
+    s.add_argument("--broker", default="localhost:1883")
+    args = ap.parse_args()
+
+    col = Collector(args.mirror)
+    stop = threading.Event()
+    if args.cmd == "broker":
+        every, _, dur = args.offline.partition("/")
+        faults = Faults(args.drop_every, args.ack_delay, args.ack_loss, (float(every), float(dur or 0)))
+        host, _, port = args.listen.rpartition(":")
+        socketserver.ThreadingTCPServer.allow_reuse_address = True
+        srv = socketserver.ThreadingTCPServer((host, int(port)), make_broker(col, faults))
+        srv.daemon_threads = True
+        threading.Thread(target=srv.serve_forever, daemon=True).start()
+        print(f"Ersatz-Broker auf {args.listen}, Spiegel {args.mirror}")
+    else:
+        host, _, port = args.broker.rpartition(":")
+        threading.Thread(target=subscribe, args=(col, host, int(port), stop), daemon=True).start()
+    try:
+        while True:
+            time.sleep(REPORT_S)
+            print(col.report())
+    except KeyboardInterrupt:
+        stop.set()
+    print(col.report())
+    if args.station:
+        station_report(args.station, args.i_sta)
+    sys.exit(0)
+
+
+if __name__ == "__main__":
+    main()
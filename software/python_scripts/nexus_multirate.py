@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - Multi-Rate Log Reader
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: Reads the multi-rate session container (<session>.nxm): every
+         channel at its own rate (wind 1 Hz, GPS per fix, BME680 per cycle,
+         rain per tip, gas/IAQ per heater run, second mast height). Lists the channels, exports one channel as CSV or
+         aligns all channels to a common period (mean/linear/last/sum).
+         Files without index (power loss) are scanned block by block,
+         damaged blocks are skipped via CRC.
+         / Liest den Multi-Rate-Container einer Session (<session>.nxm):
+         jeder Kanal in seiner eigenen Rate (Wind 1 Hz, GPS je Fix, BME680
+         je Messung, Regen je Kippung, Gas/IAQ je Heiztermin, zweite Messhöhe). Zeigt die Kanäle, exportiert einen
+         Kanal als CSV oder richtet alle Kanäle auf ein gemeinsames Raster
+         aus (Mittel/linear/letzter/Summe). Dateien ohne Index
+         (Stromausfall) werden Block für Block gelesen, beschädigte Blöcke
+         per CRC übersprungen.
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import bisect
+import csv
+import math
+import struct
+import sys
+import zlib
+from datetime import datetime, timezone
+from pathlib import Path
+
+# --- Binary format (must match main.cpp) / Binärformat (wie in main.cpp) ---
+FILE_HEADER = struct.Struct("<4sBBxxII")          # "NXMR", version, streams, session id, station id
+STREAM_DESC = struct.Struct("<BBH8s48s")          # id, record size, period ms (0 = irregular), name, fields
+BLOCK_HEADER = struct.Struct("<HBBHHQ")           # "BK", stream, irregular, count, dt ms, t0 (UTC ms)
+INDEX_ENTRY = struct.Struct("<BxHIQ")             # stream, count, offset, t0
+FOOTER = struct.Struct("<I4s")                    # index offset, "NXIE"
+BLOCK_MAGIC = 0x4B42
+# Standard-Ausrichtung je Kanal
+DEFAULT_METHOD = {"wind": "mean", "bme": "linear", "gps": "last", "rain": "sum", "gas": "last", "mast": "linear",
+                  "dalpha": "linear"}
+
+
+class Stream:
+    def __init__(self, sid: int, rec_size: int, period_ms: int, name: str, fields: str):
+        self.id, self.rec_size, self.period_ms, self.name = sid, rec_size, period_ms, name
+        self.fields = []                          # (Name, Struct-Code, Skala)
+        for f in fields.split(","):
+            n, code, scale = f.split(":")
+            self.fields.append((n, code, float(scale)))
+        self.fmt = struct.Struct("<" + "".join(c for _, c, _ in self.fields))
+        self.t, self.rows = [], []                # UTC-ms, Werte (skaliert)
+
+
+def cstr(b: bytes) -> str:
+    return b.split(b"\0", 1)[0].decode("ascii", "replace")
+
+
+def read_block(data: bytes, off: int, streams: dict):
+    """Returns (stream, t0, dt, deltas, payload, next offset) or None if the block is damaged."""
+    if off + BLOCK_HEADER.size > len(data):
+        return None
+    magic, sid, irregular, n, dt, t0 = BLOCK_HEADER.unpack_from(data, off)
+    if magic != BLOCK_MAGIC or sid not in streams or n == 0:
+        return None
+    s = streams[sid]
+    dlen = 2 * n if irregular else 0
+    end = off + BLOCK_HEADER.size + dlen + n * s.rec_size
+    if end + 4 > len(data) or zlib.crc32(data[off:end]) != struct.unpack_from("<I", data, end)[0]:
+        return None
+    deltas = struct.unpack_from(f"<{n}H", data, off + BLOCK_HEADER.size) if irregular else None
+    return s, t0, dt, deltas, data[end - n * s.rec_size:end], end + 4
+
+
+def load(path: Path) -> tuple:
+    data = path.read_bytes()
+    if len(data) < FILE_HEADER.size:
+        raise ValueError("short header")
+    magic, version, nstreams, session, station = FILE_HEADER.unpack_from(data)
+    if magic != b"NXMR" or version != 1:
+        raise ValueError(f"not a NEXUS multi-rate log ({magic!r}, v{version})")
+    streams, off = {}, FILE_HEADER.size
+    for _ in range(nstreams):
+        sid, size, period, name, fields = STREAM_DESC.unpack_from(data, off)
+        streams[sid] = Stream(sid, size, period, cstr(name), cstr(fields))
+        off += STREAM_DESC.size
+
+    info = {"session": session, "station": station, "indexed": False, "blocks": 0, "damaged": 0}
+    offsets = None
+    if len(data) >= off + FOOTER.size:
+        idx_off, tag = FOOTER.unpack_from(data, len(data) - FOOTER.size)
+        if tag == b"NXIE" and data[idx_off:idx_off + 4] == b"NXIX":
+            count = struct.unpack_from("<I", data, idx_off + 4)[0]
+            offsets = [INDEX_ENTRY.unpack_from(data, idx_off + 8 + i * INDEX_ENTRY.size)[2] for i in range(count)]
+            info["indexed"] = True
+    if offsets is None:                           # kein Index: der Reihe nach, bei Fehlern byteweise neu aufsetzen
+        offsets, end, magic = [], len(data), struct.pack("<H", BLOCK_MAGIC)
+        while off < end and data[off:off + 4] != b"NXIX":
+            b = read_block(data, off, streams)
+            if b:
+                offsets.append(off)
+                off = b[5]
+                continue
+            info["damaged"] += 1
+            while True:
+                off = data.find(magic, off + 1)
+                if off < 0 or read_block(data, off, streams):
+                    break
+            off = end if off < 0 else off
+
+    for o in offsets:
+        b = read_block(data, o, streams)
+        if not b:
+            info["damaged"] += 1
+            continue
+        s, t0, dt, deltas, payload, _ = b
+        t = t0
+        for i, vals in enumerate(s.fmt.iter_unpack(payload)):
+            t = t + deltas[i] if deltas else t0 + i * dt
+            s.t.append(t)
+            s.rows.append([v * sc for v, (_, _, sc) in zip(vals, s.fields)])
+        info["blocks"] += 1
+    for s in streams.values():                    # Bloecke sind je Kanal in Zeitfolge, ueber Kanaele gemischt
+        order = sorted(range(len(s.t)), key=s.t.__getitem__)
+        s.t, s.rows = [s.t[i] for i in order], [s.rows[i] for i in order]
+    return info, streams
+
+
+def iso(ms: int) -> str:
+    return datetime.fromtimestamp(ms // 1000, timezone.utc).strftime("%Y-%m-%dT%H:%M:%S") + f".{ms % 1000:03d}Z"
+
+
+def circular_mean(deg: tuple) -> float:
+    """Wind direction mean over the vector; -1 (calm) is left out. / Richtungsmittel, Flaute (-1) zählt nicht."""
+    v = [math.radians(d) for d in deg if d >= 0]
+    if not v:
+        return -1.0
+    return round(math.degrees(math.atan2(sum(map(math.sin, v)), sum(map(math.cos, v)))), 1) % 360.0
+
+
+def align(s: Stream, grid: list, period: int, method: str) -> list:
+    """One value row per grid point t covering [t, t + period)."""
+    out = []
+    for t in grid:
+        lo, hi = bisect.bisect_left(s.t, t), bisect.bisect_left(s.t, t + period)
+        row = None
+        if method in ("mean", "sum") and hi > lo:
+            cols = list(zip(*s.rows[lo:hi]))
+            row = [sum(c) if method == "sum" else circular_mean(c) if f[0] == "dir" else sum(c) / len(c)
+                   for c, f in zip(cols, s.fields)]
+        elif method == "sum":
+            row = [0.0] * len(s.fields) if s.t and s.t[0] <= t + period and t <= s.t[-1] else None
+        elif method == "last" and hi > 0:
+            row = s.rows[hi - 1]
+        elif method == "linear" and 0 < lo < len(s.t):
+            (t0, r0), (t1, r1) = (s.t[lo - 1], s.rows[lo - 1]), (s.t[lo], s.rows[lo])
+            w = (t - t0) / (t1 - t0)
+            row = [a + (b - a) * w for a, b in zip(r0, r1)]
+        elif method == "linear" and lo < len(s.t) and s.t[lo] == t:
+            row = s.rows[lo]
+        out.append(row)
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS multi-rate log reader / Multi-Rate-Log lesen")
+    ap.add_argument("file", type=Path, help="<session>.nxm")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    sub.add_parser("info", help="Channels and sample counts / Kanäle und Probenzahl")
+    ex = sub.add_parser("export", help="One channel at its own rate / Ein Kanal in eigener Rate")
+    ex.add_argument("--stream", required=True)
+    al = sub.add_parser("align", help="All channels on a common grid / Alle Kanäle auf gemeinsamem Raster")
+    al.add_argument("--period", type=float, default=8.0, help="Seconds / Sekunden")
+    al.add_argument("--method", action="append", default=[], metavar="STREAM=mean|linear|last|sum")
+    for p in (ex, al):
+        p.add_argument("-o", "--output", type=Path, help="CSV (default: stdout)")
+    args = ap.parse_args()
+
+    try:
+        info, streams = load(args.file)
+    except (OSError, ValueError, struct.error) as e:
+        print(f"[FEHLER] {args.file}: {e}")
+        sys.exit(2)
+    by_name = {s.name: s for s in streams.values()}
+
+    if args.cmd == "info":
+        print(f"Session {info['session']}, Station {info['station']:08X}, {info['blocks']} Blöcke "
+              f"({'mit Index' if info['indexed'] else 'ohne Index'}), beschädigt: {info['damaged']}")
+        for s in streams.values():
+            rate = f"{s.period_ms} ms" if s.period_ms else "unregelmäßig"
+            span = f"{iso(s.t[0])} .. {iso(s.t[-1])}" if s.t else "-"
+            print(f"  {s.name:5} {rate:>13}  {len(s.t):7} Proben  {span}  [{', '.join(f[0] for f in s.fields)}]")
+        sys.exit(1 if info["damaged"] else 0)
+
+    fh = open(args.output, "w", newline="", encoding="utf-8") if args.output else sys.stdout
+    w = csv.writer(fh)
+    if args.cmd == "export":
+        s = by_name.get(args.stream)
+        if not s:
+            print(f"[FEHLER] Kanal '{args.stream}' unbekannt ({', '.join(by_name)})", file=sys.stderr)
+            sys.exit(2)
+        w.writerow(["utc", "t_ms"] + [f[0] for f in s.fields])
+        for t, r in zip(s.t, s.rows):
+            w.writerow([iso(t), t] + [f"{v:g}" for v in r])
+    else:
+        methods = dict(DEFAULT_METHOD)
+        for m in args.method:
+            k, _, v = m.partition("=")
+            methods[k] = v
+        period = int(args.period * 1000)
+        ts = [t for s in streams.values() for t in s.t]
+        if not ts:
+            sys.exit(0)
+        grid = list(range(min(ts) // period * period, max(ts) + 1, period))
+        cols = [(s, align(s, grid, period, methods.get(s.name, "last"))) for s in streams.values()]
+        w.writerow(["utc", "t_ms"] + [f"{s.name}_{f[0]}" for s, _ in cols for f in s.fields])
+        for i, t in enumerate(grid):
+            row = [iso(t), t]
+            for s, vals in cols:
+                row += [f"{v:g}" for v in vals[i]] if vals[i] else [""] * len(s.fields)
+            w.writerow(row)
+    if args.output:
+        fh.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - Soak Test Monitor
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: Drives a station built with -DNEXUS_SOAK (time lapse, simulated
+         sensors) for simulated weeks: phones poll the web interface like
+         in the field, /health is read after every simulated day and
+         written to a per-day report (CSV). With -DNEXUS_FAULTS it also
+         opens never-finished connections during the web_stall phase and
+         prints the per-fault results (/faults). Exit code 1 on any
+         invariant violation.
+         / Begleitet eine mit -DNEXUS_SOAK gebaute Station (Zeitraffer,
+         simulierte Sensoren) über simulierte Wochen: Handys fragen das
+         Web-Interface wie im Feld ab, /health wird nach jedem simulierten
+         Tag gelesen und als Tagesbericht (CSV) geschrieben. Mit
+         -DNEXUS_FAULTS öffnet es in der Phase web_stall zusätzlich nie
+         abgeschlossene Verbindungen und zeigt die Ergebnisse je Fehler
+         (/faults). Exit-Code 1 bei verletzten Invarianten.
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import csv
+import json
+import random
+import socket
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+from pathlib import Path
+
+# **********************************************************
+# * CONFIGURATION / KONFIGURATION
+# **********************************************************
+DEFAULT_HOST = "192.168.4.1"          # NEXUS Access Point
+DEFAULT_DAYS = 14
+DEFAULT_CLIENTS = 3
+DEFAULT_REPORT = Path(__file__).resolve().parent / "nexus_soak_report.csv"
+HEALTH_POLL_S = 10
+TIMEOUT_S = 5
+
+# Abfragemix eines Handys: (Pfad, Intervall in Echtzeit-Sekunden) wie im Web-Interface
+TRAFFIC = [("/data", 2.0), ("/windrose", 30.0), ("/grid", 30.0), ("/summary", 60.0), ("/perf", 60.0)]
+REPORT_FIELDS = ["day", "cycles", "records", "lost", "period_viol", "period_max_dev_ms", "backwards",
+                 "heap_min", "block_min", "drift_s", "loop_max_ms", "pool_fails", "violations",
+                 "web_requests", "web_errors", "web_p95_ms"]
+
+
+def get_json(base: str, path: str) -> dict:
+    with urllib.request.urlopen(base + path, timeout=TIMEOUT_S) as resp:
+        return json.loads(resp.read())
+
+
+class Phone(threading.Thread):
+    """
+    One web client with the dashboard's polling mix; counters are read and
+    reset per simulated day. / Ein Web-Client mit dem Abfragemix des Dashboards.
+    """
+
+    def __init__(self, base: str, stop: threading.Event):
+        super().__init__(daemon=True)
+        self.base, self.stop = base, stop
+        self.lock = threading.Lock()
+        self.latencies, self.errors = [], 0
+
+    def run(self):
+        due = {p: time.time() + random.uniform(0, iv) for p, iv in TRAFFIC}
+        while not self.stop.is_set():
+            path = min(due, key=due.get)
+            self.stop.wait(max(0.0, due[path] - time.time()))
+            start = time.time()
+            try:
+                with urllib.request.urlopen(self.base + path, timeout=TIMEOUT_S) as resp:
+                    resp.read()
+                with self.lock:
+                    self.latencies.append((time.time() - start) * 1000.0)
+            except (urllib.error.URLError, OSError):
+                with self.lock:
+                    self.errors += 1
+            due[path] = start + dict(TRAFFIC)[path]
+
+    def take(self) -> tuple:
+        with self.lock:
+            lat, err = self.latencies, self.errors
+            self.latencies, self.errors = [], 0
+        return lat, err
+
+
+class Staller(threading.Thread):
+    """
+    Follows the station's fault plan: while /faults reports web_stall, holds
+    `param` connections that send half a request and never read.
+    / Hält während web_stall Verbindungen mit halber Anfrage offen.
+    """
+
+    def __init__(self, base: str, stop: threading.Event):
+        super().__init__(daemon=True)
+        self.base, self.stop = base, stop
+        url = urllib.parse.urlsplit(base)
+        self.addr = (url.hostname, url.port or 80)
+        self.socks = []
+
+    def run(self):
+        while not self.stop.wait(2.0):
+            try:
+                faults = get_json(self.base, "/faults")
+            except urllib.error.HTTPError:
+                return                                  # Firmware ohne -DNEXUS_FAULTS
+            except (urllib.error.URLError, OSError, ValueError):
+                continue
+            want = faults["param"] if faults["active"] == "web_stall" else 0
+            while len(self.socks) > want:
+                self.socks.pop().close()
+            while len(self.socks) < want:
+                try:
+                    s = socket.create_connection(self.addr, timeout=TIMEOUT_S)
+                    s.sendall(b"GET /data HTTP/1.1\r\nHost: nexus\r\n")   # Leerzeile fehlt absichtlich
+                    self.socks.append(s)
+                except OSError:
+                    break
+        for s in self.socks:
+            s.close()
+
+
+def print_faults(base: str):
+    try:
+        faults = get_json(base, "/faults")
+    except (urllib.error.URLError, OSError, ValueError):
+        return
+    b = faults["baseline"]
+    print(f"Fehlerinjektion (t = {faults['t_s']} s), Basis: {b['cycles']} Zyklen, Jitter max {b['max_dev_ms']:+} ms, verloren {b['lost']}")
+    for p in faults["phases"]:
+        d, a = p["during"], p["after"]
+        rec = f"{p['recovery_s']:.1f} s" if p["recovery_s"] is not None else "nicht erholt"
+        print(f"  {p['fault']:13} ({p['param']:>3}): während {d['cycles']:3} Zyklen, Jitter max {d['max_dev_ms']:+6} ms, verloren {d['lost']} | "
+              f"danach Jitter max {a['max_dev_ms']:+6} ms, verloren {a['lost']} | Erholung {rec}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS soak test monitor / Dauertest-Begleiter")
+    ap.add_argument("--host", default=DEFAULT_HOST)
+    ap.add_argument("--days", type=int, default=DEFAULT_DAYS, help="Simulated days / Simulierte Tage")
+    ap.add_argument("--clients", type=int, default=DEFAULT_CLIENTS)
+    ap.add_argument("--report", type=Path, default=DEFAULT_REPORT)
+    args = ap.parse_args()
+    base = args.host if args.host.startswith("http") else f"http://{args.host}"
+
+    health = get_json(base, "/health")
+    print(f"Station im Zeitraffer x{health['speed']}, Tag {health['day']} - 1 Tag = {86400 / health['speed'] / 60:.0f} min")
+    if health["speed"] == 1:
+        print("[WARN] Firmware ohne -DNEXUS_SOAK: Tage vergehen in Echtzeit.")
+    stop = threading.Event()
+    phones = [Phone(base, stop) for _ in range(args.clients)]
+    for p in phones:
+        p.start()
+    Staller(base, stop).start()
+
+    reported, first = health["day"], health["day"]
+    violations = 0
+    with open(args.report, "w", newline="", encoding="utf-8") as fh:
+        w = csv.DictWriter(fh, fieldnames=REPORT_FIELDS)
+        w.writeheader()
+        try:
+            while reported - first < args.days:
+                time.sleep(HEALTH_POLL_S)
+                try:
+                    health = get_json(base, "/health")
+                except (urllib.error.URLError, OSError, ValueError) as e:
+                    print(f"[WARN] /health nicht erreichbar ({e})")
+                    continue
+                if health["day"] < reported:
+                    print("[FEHLER] Station neu gestartet (Tageszähler zurückgesetzt).")
+                    violations += 1
+                    reported = first = health["day"]
+                    continue
+                closed = [d for d in health["days"] if reported <= d["day"] < health["day"]]
+                if not closed:
+                    continue
+                lat, err = [], 0
+                for p in phones:
+                    l, e = p.take()
+                    lat += l
+                    err += e
+                lat.sort()
+                for d in closed:   # Web-Zahlen gehören zum zuletzt abgeschlossenen Tag
+                    row = {k: d.get(k) for k in REPORT_FIELDS[:13]}
+                    last = d is closed[-1]
+                    row.update(web_requests=len(lat) if last else 0, web_errors=err if last else 0,
+                               web_p95_ms=round(lat[int(0.95 * (len(lat) - 1))]) if last and lat else "")
+                    w.writerow(row)
+                    fh.flush()
+                    violations += d["violations"]
+                    print(f"Tag {d['day']:3}: {d['records']}/{d['cycles']} Datensätze, verloren {d['lost']}, "
+                          f"Periode max {d['period_max_dev_ms']:+} ms, Heap min {d['heap_min']} B (Block {d['block_min']} B), "
+                          f"Drift {d['drift_s']} s, loop max {d['loop_max_ms']} ms -> "
+                          + ("OK" if not d["violations"] else f"{d['violations']} VERLETZUNG(EN)"))
+                reported = health["day"]
+        except KeyboardInterrupt:
+            print("Abgebrochen.")
+    stop.set()
+    print_faults(base)
+    print(f"Bericht: {args.report} - {reported - first} Tag(e), {violations} Verletzung(en)")
+    raise SystemExit(1 if violations else 0)
+
+
+if __name__ == "__main__":
+    main()
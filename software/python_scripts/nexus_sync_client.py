@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - Incremental Log Sync Client
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: Keeps a local mirror of all NEXUS sessions. Only records newer than
+         the local cursor (session id + sequence number) are fetched via
+         /sync, verified by CRC-32 and appended. Interrupted transfers simply
+         resume at the next visit.
+         / Hält einen lokalen Spiegel aller NEXUS-Sessions. Über /sync werden
+         nur Datensätze nach dem lokalen Cursor (Session-ID + Sequenznummer)
+         geholt, per CRC-32 geprüft und angehängt. Abgebrochene Übertragungen
+         werden beim nächsten Besuch einfach fortgesetzt.
+         --transport usb fetches over the USB cable (nexus_usb_link.py)
+         instead of the access point. / --transport usb holt über das
+         USB-Kabel statt über den Access Point.
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import binascii
+import datetime
+import json
+import os
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+from pathlib import Path
+
+# **********************************************************
+# * CONFIGURATION / KONFIGURATION
+# **********************************************************
+DEFAULT_HOST = "192.168.4.1"          # NEXUS Access Point
+DEFAULT_MIRROR = Path(__file__).resolve().parent / "nexus_mirror"
+BATCH_SIZE = 256                      # Max. Datensätze pro Anfrage (Firmware: SYNC_MAX_BATCH)
+RETRIES = 5                           # Wiederholungen bei Verbindungsabbruch
+TIMEOUT_S = 10
+
+# --- Binary formats (must match main.cpp) / Binärformate (wie in main.cpp) ---
+LOGBIN_HEADER = struct.Struct("<4sBBxxII")           # "NXLB", version, rec size, session id, station id
+BATCH_HEADER = struct.Struct("<4sBBHIIII")           # "NXSB", version, rec size, count, station, session, first seq, total
+LOGBIN_VERSION = 2
+RECORD = struct.Struct("<IIhHHHHhHiiBBBbHHhh")       # LogRecord v2
+RECORD_FIELDS = ["Seq", "Unix", "Temp", "Hum", "Pres", "WindAvg", "WindGust", "WindDir", "Rain",
+                 "Lat", "Lon", "Flags", "Cloud", "Sats", "DTemp", "Ms", "Span", "BmeDt", "GpsDt"]
+REC_DT_NONE = -32768                                 # Kanal nie erfasst
+CSV_HEADER = ("Seq,UTC,Temp,Hum,Pres,WindAvg,WindGust,WindDir,Rain,Lat,Lon,Fix,Stationary,Synced,Cloud,Sats,"
+              "Span,BME_dt,GPS_dt,BME_stale,GPS_stale,RTC_time")
+
+
+class BatchError(Exception):
+    """Corrupt or truncated batch / Beschädigter oder unvollständiger Batch."""
+
+
+def decode_record(raw: bytes) -> dict:
+    """
+    Decodes one LogRecord into physical units. Unix is the centre of the
+    wind/rain interval (with ms), BmeDt/GpsDt the acquisition times relative
+    to it in s (None = never acquired), DTemp the upper mast sensor minus
+    the lower one in K (None = no second sensor).
+    Dekodiert einen LogRecord in physikalische Einheiten. Unix ist die Mitte
+    des Wind/Regen-Intervalls (mit ms), BmeDt/GpsDt die Erfassungszeiten
+    relativ dazu in s (None = nie erfasst), DTemp oben minus unten am Mast
+    in K (None = kein zweiter Sensor).
+    """
+    v = dict(zip(RECORD_FIELDS, RECORD.unpack_from(raw)))
+    return {
+        "Seq": v["Seq"], "Unix": v["Unix"] + v["Ms"] / 1000.0,
+        "Temp": v["Temp"] / 100.0, "Hum": v["Hum"] / 100.0, "Pres": v["Pres"] / 10.0,
+        "WindAvg": v["WindAvg"] / 100.0, "WindGust": v["WindGust"] / 100.0, "WindDir": v["WindDir"],
+        "Rain": v["Rain"] / 100.0, "Lat": v["Lat"] / 1e7, "Lon": v["Lon"] / 1e7,
+        "Fix": bool(v["Flags"] & 1), "Stationary": bool(v["Flags"] & 2), "Synced": bool(v["Flags"] & 4),
+        "Cloud": v["Cloud"], "Sats": v["Sats"], "Span": v["Span"] / 100.0,
+        "BmeDt": None if v["BmeDt"] == REC_DT_NONE else v["BmeDt"] / 100.0,
+        "GpsDt": None if v["GpsDt"] == REC_DT_NONE else v["GpsDt"] / 100.0,
+        "BmeStale": bool(v["Flags"] & 8), "GpsStale": bool(v["Flags"] & 16), "RtcTime": bool(v["Flags"] & 32),
+        "DTemp": v["DTemp"] / 10.0 if v["Flags"] & 64 else None, "Inversion": bool(v["Flags"] & 128),
+    }
+
+
+def fmt_dt(x) -> str:
+    return "" if x is None else f"{x:.2f}"
+
+
+def record_to_csv(r: dict) -> str:
+    ms = round(r["Unix"] * 1000)
+    utc = datetime.datetime.fromtimestamp(ms // 1000, datetime.timezone.utc).strftime("%Y-%m-%d %H:%M:%S") + f".{ms % 1000:03d}"
+    return (f"{r['Seq']},{utc},{r['Temp']:.2f},{r['Hum']:.2f},{r['Pres']:.1f},{r['WindAvg']:.2f},{r['WindGust']:.2f},"
+            f"{r['WindDir']},{r['Rain']:.2f},{r['Lat']:.7f},{r['Lon']:.7f},{int(r['Fix'])},{int(r['Stationary'])},"
+            f"{int(r['Synced'])},{r['Cloud']},{r['Sats']},{r['Span']:.2f},{fmt_dt(r['BmeDt'])},{fmt_dt(r['GpsDt'])},"
+            f"{int(r['BmeStale'])},{int(r['GpsStale'])},{int(r['RtcTime'])}")
+
+
+def parse_batch(data: bytes) -> tuple:
+    """
+    Checks length and CRC of a /sync response and returns (header, records).
+    Prüft Länge und CRC einer /sync-Antwort und liefert (Header, Datensätze).
+    """
+    if len(data) < BATCH_HEADER.size + 4:
+        raise BatchError("short response")
+    magic, version, rec_size, count, station, session, first, total = BATCH_HEADER.unpack_from(data)
+    if magic != b"NXSB" or rec_size != RECORD.size:
+        raise BatchError(f"unexpected format {magic!r} v{version} size {rec_size}")
+    end = BATCH_HEADER.size + count * rec_size
+    if len(data) != end + 4:
+        raise BatchError(f"length {len(data)} != {end + 4}")
+    crc, = struct.unpack_from("<I", data, end)
+    if binascii.crc32(data[:end]) != crc:
+        raise BatchError("CRC mismatch")
+    hdr = {"station": station, "session": session, "first": first, "count": count, "total": total}
+    return hdr, data[BATCH_HEADER.size:end]
+
+
+class SyncClient:
+    def __init__(self, host: str, mirror: Path, batch: int = BATCH_SIZE, retries: int = RETRIES, link=None):
+        self.base = host if host.startswith("http") else f"http://{host}"
+        self.link = link                      # nexus_usb_link.UsbLink oder None (WLAN)
+        self.mirror = mirror
+        self.batch = batch
+        self.retries = retries
+        self.bytes_rx = 0
+
+    def _get(self, path: str) -> bytes:
+        last = None
+        for attempt in range(self.retries):
+            try:
+                if self.link:
+                    code, _, data = self.link.get(path)
+                    if code != 200:
+                        raise urllib.error.URLError(f"HTTP {code}")
+                else:
+                    with urllib.request.urlopen(self.base + path, timeout=TIMEOUT_S) as resp:
+                        data = resp.read()
+                self.bytes_rx += len(data)
+                return data
+            except (urllib.error.URLError, OSError) as e:
+                last = e
+                time.sleep(min(2 ** attempt, 15))
+        raise ConnectionError(f"{path}: {last}")
+
+    def session_paths(self, station: int, session: int) -> tuple:
+        d = self.mirror / f"{station:08x}"
+        d.mkdir(parents=True, exist_ok=True)
+        return d / f"{session}.bin", d / f"{session}.csv"
+
+    def local_cursor(self, station: int, session: int) -> int:
+        """
+        Cursor = number of complete records in the local mirror. A partially
+        written record (power loss on the laptop) is cut off.
+        / Cursor = Anzahl vollständiger Datensätze im Spiegel. Ein halb
+        geschriebener Datensatz wird abgeschnitten.
+        """
+        bin_path, _ = self.session_paths(station, session)
+        if not bin_path.exists():
+            return 0
+        size = bin_path.stat().st_size
+        with open(bin_path, "rb") as fh:
+            hdr = fh.read(LOGBIN_HEADER.size)
+        if len(hdr) == LOGBIN_HEADER.size and LOGBIN_HEADER.unpack(hdr)[2] != RECORD.size:
+            raise BatchError(f"{bin_path} has an older record format - move it away to resync")
+        n = max(0, size - LOGBIN_HEADER.size) // RECORD.size
+        if size > LOGBIN_HEADER.size + n * RECORD.size:
+            with open(bin_path, "r+b") as fh:
+                fh.truncate(LOGBIN_HEADER.size + n * RECORD.size)
+        return n
+
+    def sync_session(self, station: int, session: int) -> int:
+        bin_path, csv_path = self.session_paths(station, session)
+        cursor = self.local_cursor(station, session)
+        fetched = 0
+        while True:
+            for attempt in range(self.retries):
+                try:
+                    hdr, payload = parse_batch(self._get(f"/sync?session={session}&seq={cursor}&max={self.batch}"))
+                    break
+                except BatchError as e:
+                    print(f"  [WARN] Batch ab {cursor} verworfen ({e}), neuer Versuch...")
+            else:
+                raise ConnectionError(f"session {session}: no valid batch after {self.retries} attempts")
+            if hdr["first"] != cursor or hdr["session"] != session:
+                raise BatchError(f"cursor mismatch: asked {session}/{cursor}, got {hdr['session']}/{hdr['first']}")
+            if hdr["count"] == 0:
+                return fetched
+            new_file = not bin_path.exists()
+            with open(bin_path, "ab") as fb, open(csv_path, "a", encoding="utf-8") as fc:
+                if new_file:
+                    fb.write(LOGBIN_HEADER.pack(b"NXLB", LOGBIN_VERSION, RECORD.size, session, station))
+                    fc.write(CSV_HEADER + "\n")
+                fb.write(payload)
+                fb.flush()
+                os.fsync(fb.fileno())
+                for i in range(hdr["count"]):
+                    fc.write(record_to_csv(decode_record(payload[i * RECORD.size:(i + 1) * RECORD.size])) + "\n")
+            cursor += hdr["count"]
+            fetched += hdr["count"]
+            print(f"  Session {session}: {cursor}/{hdr['total']} Datensätze")
+            if cursor >= hdr["total"]:
+                return fetched
+
+    def run(self) -> int:
+        start, self.bytes_rx = time.time(), 0
+        info = json.loads(self._get("/sync/sessions"))
+        station = info["station"]
+        if info.get("rec_size", RECORD.size) != RECORD.size:
+            print(f"[FEHLER] Unbekannte Datensatzgröße {info['rec_size']} - Client aktualisieren.")
+            return 0
+        print(f"Station {station:08x}: {len(info['sessions'])} Session(s)")
+        total = 0
+        for s in info["sessions"]:
+            if s.get("rec_size", RECORD.size) != RECORD.size:
+                print(f"  Session {s['id']}: älteres Datensatzformat ({s['rec_size']} Bytes) - bitte direkt von der SD-Karte kopieren.")
+                continue
+            if self.local_cursor(station, s["id"]) >= s["records"]:
+                continue
+            total += self.sync_session(station, s["id"])
+        dt = max(time.time() - start, 1e-6)
+        print(f"Fertig: {total} neue Datensätze, {self.bytes_rx / 1024:.1f} KB in {dt:.1f} s ({self.bytes_rx / 1024 / dt:.1f} KB/s)")
+        return total
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS incremental sync / Inkrementeller NEXUS-Abgleich")
+    ap.add_argument("--host", default=DEFAULT_HOST, help="Station address / Adresse der Station")
+    ap.add_argument("--mirror", type=Path, default=DEFAULT_MIRROR, help="Local mirror directory / Lokaler Spiegel")
+    ap.add_argument("--batch", type=int, default=BATCH_SIZE)
+    ap.add_argument("--transport", choices=["wifi", "usb"], default="wifi", help="Access point or USB cable / AP oder USB-Kabel")
+    ap.add_argument("--port", help="USB CDC port (default: first /dev/ttyACM*)")
+    args = ap.parse_args()
+    link = None
+    if args.transport == "usb":
+        from nexus_usb_link import UsbLink, find_port
+        link = UsbLink(args.port or find_port())
+    try:
+        SyncClient(args.host, args.mirror, args.batch, link=link).run()
+    except (ConnectionError, BatchError) as e:
+        print(f"[ABBRUCH] {e} - beim nächsten Start wird ab dem letzten Cursor fortgesetzt.")
+        sys.exit(1)
+    finally:
+        if link:
+            link.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+NEXUS - USB Link
+Part of the NEXUS Bat Research Project
+
+SPDX-FileCopyrightText: 2026 Jochen Roth
+SPDX-License-Identifier: CC-BY-NC-4.0
+---------------------------------------------------------------------
+Copyright (C) 2025-2026 Jochen Roth
+
+This work is licensed under the Creative Commons Attribution-NonCommercial
+4.0 International License. To view a copy of this license, visit
+http://creativecommons.org/licenses/by-nc/4.0/ or send a letter to
+Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+---------------------------------------------------------------------
+Project: NEXUS (Environmental Data & Bioacoustics)
+Purpose: Talks HTTP to the station over the USB cable (native USB port,
+         firmware built with USB_LINK). `proxy` serves the web interface
+         on localhost for the browser, `get` fetches one endpoint, `ap`
+         switches the station's access point, `bench` compares bulk log
+         downloads (/sync) over USB and WiFi. POSIX serial ports only
+         (Linux/macOS), no extra packages.
+         / Spricht HTTP mit der Station über das USB-Kabel (natives USB,
+         Firmware mit USB_LINK). `proxy` stellt das Web-Interface auf
+         localhost für den Browser bereit, `get` holt einen Endpunkt, `ap`
+         schaltet den Access Point der Station, `bench` vergleicht den
+         Log-Download (/sync) über USB und WLAN. Nur POSIX-Schnittstellen
+         (Linux/macOS), keine Zusatzpakete.
+Version: 1.0.0
+Date:    18.10.2026
+"""
+
+import argparse
+import glob
+import http.server
+import json
+import os
+import select
+import shutil
+import struct
+import sys
+import tempfile
+import termios
+import threading
+import time
+from pathlib import Path
+
+# **********************************************************
+# * CONFIGURATION / KONFIGURATION
+# **********************************************************
+DEFAULT_PORT = "/dev/ttyACM0"         # macOS: /dev/cu.usbmodem*
+DEFAULT_LISTEN = "127.0.0.1:8080"
+TIMEOUT_S = 20                        # Firmware: USB_TIMEOUT_MS + Reserve
+STATUS_TEXT = {1: "web server not reachable", 2: "timeout on the station", 3: "USB write failed"}
+
+
+class UsbLinkError(OSError):
+    """Transport error on the USB link / Übertragungsfehler auf der USB-Verbindung."""
+
+
+class UsbLink:
+    """
+    One request at a time over the CDC port: "NXU1" + u32 length + HTTP/1.0
+    request out, "NXUD" data frames and a closing "NXUE" status frame back.
+    / Eine Anfrage nach der anderen über den CDC-Port.
+    """
+
+    def __init__(self, port: str):
+        self.port = port
+        self.fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+        attr = termios.tcgetattr(self.fd)
+        attr[0] = attr[1] = attr[3] = 0                  # raw: kein Echo, keine Zeilenumsetzung
+        attr[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attr[6][termios.VMIN], attr[6][termios.VTIME] = 0, 0
+        termios.tcsetattr(self.fd, termios.TCSANOW, attr)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        self.lock = threading.Lock()
+        self.buf = b""
+
+    def close(self):
+        os.close(self.fd)
+
+    def _read(self, n: int, deadline: float) -> bytes:
+        while len(self.buf) < n:
+            left = deadline - time.time()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                raise UsbLinkError(f"{self.port}: no answer")
+            chunk = os.read(self.fd, 65536)
+            if not chunk:
+                raise UsbLinkError(f"{self.port}: disconnected")
+            self.buf += chunk
+        out, self.buf = self.buf[:n], self.buf[n:]
+        return out
+
+    def request(self, method: str, path: str, headers: dict = None) -> bytes:
+        """Returns the raw HTTP response (status line, headers, body). / Liefert die rohe HTTP-Antwort."""
+        lines = [f"{method} {path} HTTP/1.0", "Host: nexus", "Connection: close"]
+        lines += [f"{k}: {v}" for k, v in (headers or {}).items() if k.lower() not in ("host", "connection")]
+        req = ("\r\n".join(lines) + "\r\n\r\n").encode()
+        with self.lock:
+            self.buf = b""
+            os.write(self.fd, b"NXU1" + struct.pack("<I", len(req)) + req)
+            out = bytearray()
+            deadline = time.time() + TIMEOUT_S
+            while True:
+                tag = self._read(4, deadline)
+                while tag not in (b"NXUD", b"NXUE"):          # Fremdbytes (z. B. Bootmeldungen) überspringen
+                    tag = tag[1:] + self._read(1, deadline)
+                n, = struct.unpack("<H", self._read(2, deadline))
+                data = self._read(n, deadline)
+                if tag == b"NXUE":
+                    status, = struct.unpack("<H", data)
+                    if status:
+                        raise UsbLinkError(f"{path}: {STATUS_TEXT.get(status, status)}")
+                    return bytes(out)
+                out += data
+                deadline = time.time() + TIMEOUT_S
+
+    def get(self, path: str) -> tuple:
+        """Returns (status code, headers, body). / Liefert (Status, Header, Inhalt)."""
+        raw = self.request("GET", path)
+        head, _, body = raw.partition(b"\r\n\r\n")
+        lines = head.decode("latin-1").split("\r\n")
+        code = int(lines[0].split()[1])
+        hdrs = {k.strip().lower(): v.strip() for k, _, v in (l.partition(":") for l in lines[1:])}
+        return code, hdrs, body
+
+
+def find_port() -> str:
+    ports = sorted(glob.glob("/dev/ttyACM*") + glob.glob("/dev/cu.usbmodem*"))
+    return ports[0] if ports else DEFAULT_PORT
+
+
+def make_proxy(link: UsbLink):
+    class Proxy(http.server.BaseHTTPRequestHandler):
+        def _forward(self):
+            try:
+                raw = link.request(self.command, self.path, {k: v for k, v in self.headers.items()})
+            except UsbLinkError as e:
+                self.send_error(502, str(e))
+                return
+            self.wfile.write(raw)                           # HTTP/1.0-Antwort der Station unverändert weiterreichen
+            self.close_connection = True
+
+        do_GET = do_HEAD = _forward
+
+        def log_message(self, fmt, *args):
+            pass
+    return Proxy
+
+
+def bench(link: UsbLink, host: str, batch: int):
+    """Full /sync download of all sessions over both links into scratch mirrors. / Kompletter Download über beide Wege."""
+    from nexus_sync_client import SyncClient
+    results = []
+    for name, transport in (("USB", link), ("WLAN", None)):
+        mirror = Path(tempfile.mkdtemp(prefix="nexus_bench_"))
+        client = SyncClient(host, mirror, batch, link=transport)
+        print(f"--- {name} ---")
+        start = time.time()
+        try:
+            records = client.run()
+        except (ConnectionError, OSError) as e:
+            print(f"  [FEHLER] {e}")
+            records = None
+        dt = max(time.time() - start, 1e-6)
+        shutil.rmtree(mirror, ignore_errors=True)
+        if records is not None:
+            results.append((name, records, client.bytes_rx, dt))
+    print("\nVerbindung   Datensätze      KB        s      KB/s")
+    for name, records, nbytes, dt in results:
+        print(f"{name:10} {records:12} {nbytes / 1024:8.1f} {dt:8.1f} {nbytes / 1024 / dt:9.1f}")
+    if len(results) == 2 and results[1][3] > 0:
+        print(f"USB ist {results[1][3] / results[0][3]:.1f}x so schnell wie WLAN.")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="NEXUS USB link / Web-Interface über USB")
+    ap.add_argument("--port", default=None, help=f"CDC port (default: first /dev/ttyACM*, else {DEFAULT_PORT})")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    px = sub.add_parser("proxy", help="Web interface on localhost / Web-Interface auf localhost")
+    px.add_argument("--listen", default=DEFAULT_LISTEN)
+    g = sub.add_parser("get", help="Fetch one endpoint / Einen Endpunkt abrufen")
+    g.add_argument("path")
+    g.add_argument("-o", "--output", type=Path)
+    a = sub.add_parser("ap", help="Switch the station's access point / Access Point schalten")
+    a.add_argument("state", choices=["on", "off", "status"])
+    b = sub.add_parser("bench", help="Bulk download USB vs. WiFi / Download USB gegen WLAN")
+    b.add_argument("--host", default="192.168.4.1", help="Station address over WiFi / Adresse über WLAN")
+    b.add_argument("--batch", type=int, default=256)
+    args = ap.parse_args()
+
+    try:
+        link = UsbLink(args.port or find_port())
+    except OSError as e:
+        print(f"[FEHLER] {e}")
+        sys.exit(2)
+    try:
+        if args.cmd == "proxy":
+            host, _, port = args.listen.rpartition(":")
+            srv = http.server.ThreadingHTTPServer((host, int(port)), make_proxy(link))
+            print(f"Web-Interface über USB ({link.port}): http://{args.listen}/interface")
+            srv.serve_forever()
+        elif args.cmd == "get":
+            code, _, body = link.get(args.path)
+            if args.output:
+                args.output.write_bytes(body)
+                print(f"{code}: {len(body)} Bytes -> {args.output}")
+            else:
+                sys.stdout.buffer.write(body)
+            sys.exit(0 if code == 200 else 1)
+        elif args.cmd == "ap":
+            q = "" if args.state == "status" else f"?ap={int(args.state == 'on')}"
+            code, _, body = link.get("/link" + q)
+            print(json.dumps(json.loads(body), indent=1) if code == 200 else f"[FEHLER] {code} {body.decode(errors='replace')}")
+        else:
+            bench(link, args.host, args.batch)
+    except UsbLinkError as e:
+        print(f"[FEHLER] {e}")
+        sys.exit(1)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        link.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,8 @@
+#!/bin/sh
+# Host-Tests (ohne Arduino/ESP32, nur ein C++11-Compiler): ./tests/run_host_tests.sh
+# -Wno-implicit-fallthrough: die Task-Makros springen absichtlich per case __LINE__ in den Rumpf
+set -e
+cd "$(dirname "$0")"
+out="${TMPDIR:-/tmp}/nexus_test_tasks"
+${CXX:-g++} -std=gnu++11 -Wall -Wextra -Wno-implicit-fallthrough -Werror -o "$out" test_tasks.cpp
+"$out"
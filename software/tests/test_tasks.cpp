@@ -0,0 +1,112 @@
+/*
+ * NEXUS - Host-Tests fuer nexus_tasks.h (Task-Makros, GPS-Quittung mit Wiederholung)
+ * ---------------------------------------------------------------------
+ * Copyright (C) 2025-2026 Jochen Roth
+ * Licensed under Creative Commons Attribution-NonCommercial 4.0
+ * ---------------------------------------------------------------------
+ * Laeuft ohne Arduino/ESP32: millis() ist eine Attrappe, die GPS-Ein-/Ausgabe ein Skript.
+ * Bauen und starten: tests/run_host_tests.sh
+ */
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+static unsigned long nowMs = 0;
+unsigned long millis() { return nowMs; }
+#include "../nexus_tasks.h"
+
+static int failures = 0, checks = 0;
+#define CHECK(c) do { checks++; if (!(c)) { failures++; printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); } } while (0)
+
+// --- Task-Makros ---
+struct CountTask : Task { int steps; bool go; };
+void countRun(CountTask &t) {
+  TASK_BEGIN(t);
+  t.steps = 1; TASK_YIELD(t);
+  t.steps = 2; TASK_WAIT_UNTIL(t, t.go);
+  t.steps = 3; TASK_SLEEP(t, 100);
+  t.steps = 4;
+  TASK_END(t);
+}
+void testMacros() {
+  CountTask t{};
+  countRun(t); CHECK(t.steps == 1 && !TASK_DONE(t));              // bis zum ersten Yield
+  countRun(t); CHECK(t.steps == 2);                                 // wartet auf go
+  countRun(t); CHECK(t.steps == 2);
+  t.go = true; nowMs = 1000;
+  countRun(t); CHECK(t.steps == 3);                                 // schlaeft ab 1000
+  nowMs = 1099; countRun(t); CHECK(t.steps == 3 && !TASK_DONE(t));
+  nowMs = 1100; countRun(t); CHECK(t.steps == 4 && TASK_DONE(t));
+  t.steps = 99; countRun(t); CHECK(t.steps == 99 && TASK_DONE(t));  // fertig: tut nichts mehr
+  TASK_RESTART(t); t.go = false;
+  countRun(t); CHECK(t.steps == 1 && !TASK_DONE(t));
+}
+void testSleepAcrossWrap() {   // millis() laeuft nach ca. 49 Tagen ueber
+  CountTask t{}; t.go = true;
+  countRun(t);
+  nowMs = (unsigned long)-50; countRun(t); CHECK(t.steps == 3);   // schlaeft ab 50 ms vor dem Ueberlauf
+  nowMs = 49; countRun(t); CHECK(t.steps == 3);
+  nowMs = 50; countRun(t); CHECK(t.steps == 4 && TASK_DONE(t));
+}
+
+// --- GPS-Konfiguration ---
+struct FakeGps {
+  bool listening = false; std::vector<std::string> sent; std::deque<std::string> lines; int drains = 0;
+  void listen(bool on) { listening = on; }
+  void drain() { lines.clear(); drains++; }
+  void send(const char* body) { sent.push_back(body); }
+  bool pending() { return !lines.empty(); }
+  bool next(char* buf, size_t len) {
+    if (lines.empty()) return false;
+    snprintf(buf, len, "%s", lines.front().c_str()); lines.pop_front(); return true;
+  }
+};
+// Task ab t0 laufen lassen, bis die Boot-Pause vorbei ist und der erste Befehl raus ist
+void gpsStart(GpsConfigTask &t, FakeGps &io, unsigned long t0) {
+  nowMs = t0; gpsConfigStep(t, io);
+  nowMs = t0 + GPS_CONFIG_BOOT_MS; gpsConfigStep(t, io);
+}
+void testGpsAckFirstTry() {
+  GpsConfigTask t{}; FakeGps io;
+  nowMs = 0; gpsConfigStep(t, io); CHECK(io.sent.empty() && !io.listening);   // Boot-Pause
+  nowMs = GPS_CONFIG_BOOT_MS - 1; gpsConfigStep(t, io); CHECK(io.sent.empty());
+  nowMs = GPS_CONFIG_BOOT_MS; gpsConfigStep(t, io);
+  CHECK(io.sent.size() == 1 && io.sent[0] == GPS_CONFIG_CMD && io.listening && !TASK_DONE(t));
+  io.lines.push_back("$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A");
+  nowMs += 200; gpsConfigStep(t, io); CHECK(!t.ok && !TASK_DONE(t));   // fremde Zeile
+  io.lines.push_back("$PGKC001,242,3*2B");
+  nowMs += 100; gpsConfigStep(t, io);
+  CHECK(t.ok && TASK_DONE(t) && io.sent.size() == 1 && !io.listening && io.lines.empty());
+}
+void testGpsRetryThenAck() {
+  GpsConfigTask t{}; FakeGps io; gpsStart(t, io, 5000);
+  unsigned long first = nowMs;
+  nowMs = first + GPS_CONFIG_ACK_MS - 1; gpsConfigStep(t, io); CHECK(io.sent.size() == 1);
+  nowMs = first + GPS_CONFIG_ACK_MS; gpsConfigStep(t, io); CHECK(io.sent.size() == 2 && !TASK_DONE(t));   // zweiter Versuch
+  io.lines.push_back("$PGKC001,242,2*2A");                           // Fehler-Quittung zaehlt nicht
+  nowMs += 10; gpsConfigStep(t, io); CHECK(!t.ok && io.sent.size() == 2);
+  io.lines.push_back("$PGKC001,242,3*2B");
+  nowMs += 10; gpsConfigStep(t, io); CHECK(t.ok && TASK_DONE(t) && io.sent.size() == 2);
+}
+void testGpsGivesUp() {
+  GpsConfigTask t{}; FakeGps io; gpsStart(t, io, 0);
+  for (int i = 0; i < 100 && !TASK_DONE(t); i++) { nowMs += 250; gpsConfigStep(t, io); }
+  CHECK(TASK_DONE(t) && !t.ok && io.sent.size() == GPS_CONFIG_RETRIES && !io.listening);
+  CHECK(nowMs == GPS_CONFIG_BOOT_MS + GPS_CONFIG_RETRIES * GPS_CONFIG_ACK_MS);   // genau drei Wartefenster
+  gpsConfigStep(t, io); CHECK(io.sent.size() == GPS_CONFIG_RETRIES);
+}
+void testGpsStaleAckDropped() {   // Quittung vor dem Senden (Rest eines frueheren Versuchs) wird verworfen
+  GpsConfigTask t{}; FakeGps io;
+  nowMs = 0; gpsConfigStep(t, io);
+  io.lines.push_back("$PGKC001,242,3*2B");
+  nowMs = GPS_CONFIG_BOOT_MS; gpsConfigStep(t, io);
+  CHECK(!t.ok && io.sent.size() == 1 && io.drains >= 1);
+}
+
+int main() {
+  testMacros(); testSleepAcrossWrap();
+  testGpsAckFirstTry(); testGpsRetryThenAck(); testGpsGivesUp(); testGpsStaleAckDropped();
+  printf("%d/%d Pruefungen bestanden\n", checks - failures, checks);
+  return failures ? 1 : 0;
+}